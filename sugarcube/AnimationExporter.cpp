@@ -0,0 +1,122 @@
+#include "AnimationExporter.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+AnimationExporter::AnimationExporter() :
+	secondsPerGeneration(0.1f),
+	running(false),
+	failed(false),
+	stepsDone(0),
+	stepsTotal(1)
+{}
+
+AnimationExporter::~AnimationExporter() {
+	if (worker.joinable()) worker.join();
+}
+
+bool AnimationExporter::start(const Automata3D& simulation, int first, int last, const std::string& path) {
+	if (running) {
+		std::cout << "An animation is already being exported" << std::endl;
+		return false;
+	}
+	if (worker.joinable()) worker.join();
+
+	Automata3D copy = simulation.headlessCopy();
+	first = std::max(first, copy.getGeneration());
+	if (last < first) {
+		std::cout << "Can't export, the generation range is empty" << std::endl;
+		return false;
+	}
+
+	stepsDone = 0;
+	stepsTotal = last - copy.getGeneration() + 1;
+	failed = false;
+	running = true;
+	worker = std::thread(&AnimationExporter::run, this, std::move(copy), first, last, path);
+	return true;
+}
+
+bool AnimationExporter::isRunning() {
+	return running;
+}
+
+float AnimationExporter::progress() {
+	return static_cast<float>(stepsDone) / static_cast<float>(stepsTotal);
+}
+
+bool AnimationExporter::hasFailed() {
+	return failed;
+}
+
+void AnimationExporter::run(Automata3D simulation, int first, int last, std::string path) {
+	TRACE_THREAD_NAME("animation export");
+	TRACE_SCOPE("exportAnimation");
+
+	while (simulation.getGeneration() < first) {
+		simulation.step();
+		stepsDone++;
+	}
+
+	// every interval a block is alive for, in frames relative to first
+	struct Interval {
+		int cell;
+		int begin;
+		int end;
+	};
+	std::vector<Interval> intervals;
+	int frames = last - first + 1;
+	std::vector<int> aliveSince(simulation.cells.size(), -1);
+	for (int frame = 0; frame < frames; frame++) {
+		if (frame > 0) simulation.step();
+		const std::vector<bool>& cells = simulation.cells;
+		for (size_t i = 0; i < cells.size(); i++) {
+			if (cells[i] && aliveSince[i] < 0) {
+				aliveSince[i] = frame;
+			}
+			else if (!cells[i] && aliveSince[i] >= 0) {
+				intervals.push_back({ static_cast<int>(i), aliveSince[i], frame });
+				aliveSince[i] = -1;
+			}
+		}
+		stepsDone++;
+	}
+	for (size_t i = 0; i < aliveSince.size(); i++) {
+		if (aliveSince[i] >= 0) intervals.push_back({ static_cast<int>(i), aliveSince[i], frames });
+	}
+
+	// the toggles of a block are its interval bounds in order, blocks with
+	// identical toggles are grouped into one track
+	std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+		return a.cell != b.cell ? a.cell < b.cell : a.begin < b.begin;
+	});
+	ivec3 size = simulation.getSize();
+	std::vector<GltfExporter::VisibilityTrack> tracks;
+	std::map<std::vector<int>, size_t> trackIndices;
+	for (size_t i = 0; i < intervals.size();) {
+		int cell = intervals[i].cell;
+		std::vector<int> toggles;
+		for (; i < intervals.size() && intervals[i].cell == cell; i++) {
+			toggles.push_back(intervals[i].begin);
+			if (intervals[i].end < frames) toggles.push_back(intervals[i].end);
+		}
+
+		auto found = trackIndices.find(toggles);
+		if (found == trackIndices.end()) {
+			found = trackIndices.emplace(toggles, tracks.size()).first;
+			tracks.push_back({ toggles, {} });
+		}
+		int x = cell % size.x;
+		int y = (cell / size.x) % size.y;
+		int z = cell / (size.x * size.y);
+		tracks[found->second].translations.push_back(vec3(
+			x - (0.5f * static_cast<float>(size.x - 1)),
+			y - (0.5f * static_cast<float>(size.y - 1)),
+			z - (0.5f * static_cast<float>(size.z - 1))));
+	}
+
+	failed = !GltfExporter().exportAnimated(path.c_str(), tracks, frames, secondsPerGeneration);
+	running = false;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "Automata3D.h"
+#include "GltfExporter.h"
+
+// exports a range of generations as one animated glb. The simulation is
+// copied without render data and stepped on a background thread, each
+// block is written once with the frames it is alive in, and blocks with the
+// same lifetime share one instanced node
+class AnimationExporter {
+
+public:
+	AnimationExporter();
+	~AnimationExporter();
+
+	// generations before first are stepped through without being recorded,
+	// ranges starting before the current generation start at it instead
+	bool start(const Automata3D& simulation, int first, int last, const std::string& path);
+	bool isRunning();
+	float progress();
+	// true when the last export finished without writing its file
+	bool hasFailed();
+
+	float secondsPerGeneration;
+
+private:
+	void run(Automata3D simulation, int first, int last, std::string path);
+
+	std::thread worker;
+	std::atomic<bool> running;
+	std::atomic<bool> failed;
+	std::atomic<int> stepsDone;
+	std::atomic<int> stepsTotal;
+};
\ No newline at end of file
@@ -1,46 +1,129 @@
 #include "Automata3D.h"
+#include "GreedyMesher.h"
+#include "Profiler.h"
 
 #include <iostream>
 #include <ctime>
 
+using Vertex = Automata3D::Vertex;
+
+// shared by the render data and the occlusion calculation, which
+// stores one occlusion value per vertex of this table
+const Vertex Automata3D::cubeVertices[24] = {
+	// -Y
+	Vertex(-0.5f, -0.5f, -0.5f,     0.0f, -1.0f, 0.0f),
+	Vertex( 0.5f, -0.5f, -0.5f,     0.0f, -1.0f, 0.0f),
+	Vertex(-0.5f, -0.5f,  0.5f,     0.0f, -1.0f, 0.0f),
+	Vertex( 0.5f, -0.5f,  0.5f,     0.0f, -1.0f, 0.0f),
+	// -Z
+	Vertex( 0.5f, -0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
+	Vertex(-0.5f, -0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
+	Vertex( 0.5f,  0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
+	Vertex(-0.5f,  0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
+	// -X
+	Vertex(-0.5f, -0.5f, -0.5f,     -1.0f, 0.0f, 0.0f),
+	Vertex(-0.5f, -0.5f,  0.5f,     -1.0f, 0.0f, 0.0f),
+	Vertex(-0.5f,  0.5f, -0.5f,     -1.0f, 0.0f, 0.0f),
+	Vertex(-0.5f,  0.5f,  0.5f,     -1.0f, 0.0f, 0.0f),
+	// +Z
+	Vertex(-0.5f, -0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
+	Vertex( 0.5f, -0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
+	Vertex(-0.5f,  0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
+	Vertex( 0.5f,  0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
+	// +X
+	Vertex( 0.5f, -0.5f,  0.5f,     1.0f, 0.0f, 0.0f),
+	Vertex( 0.5f, -0.5f, -0.5f,     1.0f, 0.0f, 0.0f),
+	Vertex( 0.5f,  0.5f,  0.5f,     1.0f, 0.0f, 0.0f),
+	Vertex( 0.5f,  0.5f, -0.5f,     1.0f, 0.0f, 0.0f),
+	// +Y
+	Vertex(-0.5f,  0.5f,  0.5f,     0.0f, 1.0f, 0.0f),
+	Vertex( 0.5f,  0.5f,  0.5f,     0.0f, 1.0f, 0.0f),
+	Vertex(-0.5f,  0.5f, -0.5f,     0.0f, 1.0f, 0.0f),
+	Vertex( 0.5f,  0.5f, -0.5f,     0.0f, 1.0f, 0.0f)
+};
+
+const GLuint Automata3D::cubeIndices[36] = {
+	0, 1, 2,
+	2, 1, 3,
+	4, 5, 6,
+	6, 5, 7,
+	8, 9, 10,
+	10, 9, 11,
+	12, 13, 14,
+	14, 13, 15,
+	16, 17, 18,
+	18, 17, 19,
+	20, 21, 22,
+	22, 21, 23
+};
+
 Automata3D::Automata3D(ivec3 size, int eL, int eU, int fL, int fU) :
 	cells(size.x * size.y * size.z, 0),
+	cellOcclusion(size.x * size.y * size.z),
+	occlusionDirty(size.x * size.y * size.z, false),
 	eL(eL), eU(eU), fL(fL), fU(fU),
+	useStaticMesh(false),
 	size(size),
-	generation(1)
+	generation(1),
+	staticIndexCount(0),
+	hasRenderData(false),
+	staticMeshDirty(true)
 {
 	srand(time(NULL));
 }
 
 void Automata3D::draw() {
+	if (useStaticMesh) {
+		if (staticMeshDirty) buildStaticMesh();
+
+		// the static mesh stores world positions in the offset attribute,
+		// the cube local position is held at zero and occlusion at none
+		glBindVertexArray(staticVao);
+		glVertexAttrib3f(0, 0.0f, 0.0f, 0.0f);
+		glVertexAttribI4ui(3, 0xffffffff, 0xffffffff, 0, 0);
+		glDrawElements(GL_TRIANGLES, staticIndexCount, GL_UNSIGNED_INT, 0);
+		return;
+	}
+
 	glBindVertexArray(vao);
 	glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, blocks.size());
 }
 
 void Automata3D::step() {
 	std::vector<bool> nextFrame(size.x * size.y * size.z, false);
-
-	for (int x = 0; x < size.x; x++) {
-		for (int y = 0; y < size.y; y++) {
-			for (int z = 0; z < size.z; z++) {
-				int neighbors = countNeighbors(x, y, z);
-				// live cell
-				if (cells[z * size.x * size.y + y * size.x + x]) {
-					if (neighbors >= eL && neighbors <= eU)
-						nextFrame[z * size.x * size.y + y * size.x + x] = true;
-				}
-				// dead cell
-				else {
-					if (neighbors >= fL && neighbors <= fU)
-						nextFrame[z * size.x * size.y + y * size.x + x] = true;
+	changes.clear();
+	{
+		PROFILE_SCOPE(ProfileStage::Step);
+
+		for (int x = 0; x < size.x; x++) {
+			for (int y = 0; y < size.y; y++) {
+				for (int z = 0; z < size.z; z++) {
+					int neighbors = countNeighbors(x, y, z);
+					// live cell
+					if (cells[z * size.x * size.y + y * size.x + x]) {
+						if (neighbors >= eL && neighbors <= eU)
+							nextFrame[z * size.x * size.y + y * size.x + x] = true;
+					}
+					// dead cell
+					else {
+						if (neighbors >= fL && neighbors <= fU)
+							nextFrame[z * size.x * size.y + y * size.x + x] = true;
+					}
+					if (nextFrame[z * size.x * size.y + y * size.x + x] !=
+						cells[z * size.x * size.y + y * size.x + x])
+						changes.push_back(z * size.x * size.y + y * size.x + x);
 				}
 			}
 		}
+
+		cells = nextFrame;
+		generation++;
+		updateOcclusion(changes);
 	}
 
-	cells = nextFrame;
-	generation++;
 	rebuildInstanceArray();
+	TRACE_COUNTER("generation", generation);
+	TRACE_COUNTER("population", static_cast<int64_t>(blocks.size()));
 }
 
 int Automata3D::countNeighbors(int x, int y, int z) {
@@ -61,9 +144,34 @@ int Automata3D::countNeighbors(int x, int y, int z) {
 	return count;
 }
 
+bool Automata3D::isAlive(ivec3 pos) {
+	if (pos.x < 0 || pos.x >= size.x ||
+		pos.y < 0 || pos.y >= size.y ||
+		pos.z < 0 || pos.z >= size.z) return false;
+	return cells[pos.z * size.x * size.y + pos.y * size.x + pos.x];
+}
+
 void Automata3D::resize(ivec3 newSize) {
 	size = newSize;
 	cells.resize(newSize.x * newSize.y * newSize.z, false);
+	cellOcclusion.resize(newSize.x * newSize.y * newSize.z);
+	occlusionDirty.resize(newSize.x * newSize.y * newSize.z, false);
+}
+
+void Automata3D::setState(ivec3 newSize, int newGeneration, std::vector<bool>&& newCells) {
+	resize(newSize);
+	cells = std::move(newCells);
+	generation = newGeneration;
+	rebuildOcclusion();
+	rebuildInstanceArray();
+}
+
+void Automata3D::applyChanges(int newGeneration, const std::vector<int>& changed) {
+	changes = changed;
+	for (int idx : changes) cells[idx].flip();
+	generation = newGeneration;
+	updateOcclusion(changes);
+	rebuildInstanceArray();
 }
 
 void Automata3D::createBox(ivec3 clusterSize) {
@@ -86,6 +194,7 @@ void Automata3D::createBox(ivec3 clusterSize) {
 	}
 
 	generation = 1;
+	rebuildOcclusion();
 	rebuildInstanceArray();
 }
 
@@ -108,6 +217,7 @@ void Automata3D::createCross(int thickness, bool omitX, bool omitY, bool omitZ)
 	}
 
 	generation = 1;
+	rebuildOcclusion();
 	rebuildInstanceArray();
 }
 
@@ -127,6 +237,7 @@ void Automata3D::createCorners(int thickness) {
 	}
 
 	generation = 1;
+	rebuildOcclusion();
 	rebuildInstanceArray();
 }
 
@@ -151,91 +262,173 @@ void Automata3D::createNoise(ivec3 clusterSize) {
 	}
 
 	generation = 1;
+	rebuildOcclusion();
 	rebuildInstanceArray();
 }
 
-void Automata3D::rebuildInstanceArray() {
-	blocks.clear();
+void Automata3D::createFromGrid(GridView source) {
+	if (!source.isValid()) return;
+
+	std::fill(cells.begin(), cells.end(), false);
+	ivec3 offset = (size - source.size) / 2;
+
+	for (int x = 0; x < size.x; x++) {
+		for (int y = 0; y < size.y; y++) {
+			for (int z = 0; z < size.z; z++) {
+				if (!source.isEmpty(x - offset.x, y - offset.y, z - offset.z))
+					cells[z * size.x * size.y + y * size.x + x] = true;
+			}
+		}
+	}
+
+	generation = 1;
+	rebuildOcclusion();
+	rebuildInstanceArray();
+}
+
+uvec2 Automata3D::computeOcclusion(int x, int y, int z) {
+	// classic voxel ao, each vertex looks at the two cells beside it and
+	// the cell diagonal to it in the layer in front of its face
+	uvec2 packed(0);
+	for (int i = 0; i < 24; i++) {
+		ivec3 normal(cubeVertices[i].normal);
+		ivec3 corner(glm::sign(cubeVertices[i].pos));
+
+		// split the corner direction into the two tangents of the face
+		ivec3 side1(0), side2(0);
+		if (normal.x != 0) { side1.y = corner.y; side2.z = corner.z; }
+		if (normal.y != 0) { side1.x = corner.x; side2.z = corner.z; }
+		if (normal.z != 0) { side1.x = corner.x; side2.y = corner.y; }
+
+		ivec3 front = ivec3(x, y, z) + normal;
+		int s1 = isAlive(front + side1);
+		int s2 = isAlive(front + side2);
+		int c = isAlive(front + side1 + side2);
+		GLuint ao = (s1 && s2) ? 0 : 3 - (s1 + s2 + c);
+
+		packed[i / 16] |= ao << (2 * (i % 16));
+	}
+	return packed;
+}
 
+void Automata3D::rebuildOcclusion() {
 	for (int x = 0; x < size.x; x++) {
 		for (int y = 0; y < size.y; y++) {
 			for (int z = 0; z < size.z; z++) {
-				if (!cells[z * size.x * size.y + y * size.x + x])
-					continue;
-				blocks.push_back(vec3(
-					x - (0.5f * static_cast<float>(size.x - 1)), 
-					y - (0.5f * static_cast<float>(size.y - 1)), 
-					z - (0.5f * static_cast<float>(size.z - 1))));
+				int idx = z * size.x * size.y + y * size.x + x;
+				if (cells[idx]) cellOcclusion[idx] = computeOcclusion(x, y, z);
+			}
+		}
+	}
+}
+
+void Automata3D::updateOcclusion(const std::vector<int>& changes) {
+	// occlusion only depends on the 26 neighbors of a cell, so only live
+	// cells within one voxel of a change need to be recomputed
+	std::vector<int> dirty;
+	for (int idx : changes) {
+		ivec3 pos(idx % size.x, (idx / size.x) % size.y, idx / (size.x * size.y));
+		for (int ix = pos.x - 1; ix <= pos.x + 1; ix++) {
+			for (int iy = pos.y - 1; iy <= pos.y + 1; iy++) {
+				for (int iz = pos.z - 1; iz <= pos.z + 1; iz++) {
+					if (!isAlive(ivec3(ix, iy, iz))) continue;
+					int n = iz * size.x * size.y + iy * size.x + ix;
+					if (occlusionDirty[n]) continue;
+					occlusionDirty[n] = true;
+					dirty.push_back(n);
+				}
+			}
+		}
+	}
+
+	for (int idx : dirty) {
+		cellOcclusion[idx] = computeOcclusion(
+			idx % size.x, (idx / size.x) % size.y, idx / (size.x * size.y));
+		occlusionDirty[idx] = false;
+	}
+}
+
+void Automata3D::rebuildInstanceArray() {
+	staticMeshDirty = true;
+	{
+		PROFILE_SCOPE(ProfileStage::Rebuild);
+		blocks.clear();
+		occlusion.clear();
+
+		for (int x = 0; x < size.x; x++) {
+			for (int y = 0; y < size.y; y++) {
+				for (int z = 0; z < size.z; z++) {
+					if (!cells[z * size.x * size.y + y * size.x + x])
+						continue;
+					blocks.push_back(vec3(
+						x - (0.5f * static_cast<float>(size.x - 1)), 
+						y - (0.5f * static_cast<float>(size.y - 1)), 
+						z - (0.5f * static_cast<float>(size.z - 1))));
+					occlusion.push_back(cellOcclusion[z * size.x * size.y + y * size.x + x]);
+				}
 			}
 		}
 	}
 
-	if (blocks.size() == 0) return;
+	if (blocks.size() == 0 || !hasRenderData) return;
 
+	PROFILE_SCOPE(ProfileStage::Upload);
 	glBindVertexArray(vao);
 	glBindBuffer(GL_ARRAY_BUFFER, ibo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * blocks.size(), &blocks[0], GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glVertexAttribDivisor(2, 1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, aoBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(uvec2) * occlusion.size(), &occlusion[0], GL_DYNAMIC_DRAW);
+	glEnableVertexAttribArray(3);
+	glVertexAttribIPointer(3, 2, GL_UNSIGNED_INT, sizeof(uvec2), (void*)0);
+	glVertexAttribDivisor(3, 1);
+}
+
+void Automata3D::buildStaticMesh() {
+	PROFILE_SCOPE(ProfileStage::Rebuild);
+	std::vector<Quad> quads;
+	GreedyMesher(getGrid()).meshAll(quads);
+
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	vertices.reserve(quads.size() * 4);
+	indices.reserve(quads.size() * 6);
+	vec3 center = vec3(size) * 0.5f;
+	for (const Quad& quad : quads) {
+		GLuint first = static_cast<GLuint>(vertices.size());
+		vec3 normal(faceNormals[quad.normal]);
+		for (int c = 0; c < 4; c++) {
+			vec3 pos = vec3(quad.corners[c]) - center;
+			vertices.push_back(Vertex(pos.x, pos.y, pos.z, normal.x, normal.y, normal.z));
+		}
+		GLuint quadIndices[6] = { first, first + 1, first + 2, first + 2, first + 3, first };
+		indices.insert(indices.end(), quadIndices, quadIndices + 6);
+	}
+
+	staticIndexCount = static_cast<GLsizei>(indices.size());
+	staticMeshDirty = false;
+	if (quads.empty()) return;
+
+	glBindVertexArray(staticVao);
+	glBindBuffer(GL_ARRAY_BUFFER, staticVbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, staticEbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
 }
 
 void Automata3D::initRenderData() {
+	hasRenderData = true;
 	glGenVertexArrays(1, &vao);
 	glGenBuffers(1, &vbo);
 	glGenBuffers(1, &ebo);
 	glGenBuffers(1, &ibo);
+	glGenBuffers(1, &aoBuffer);
 
 	glBindVertexArray(vao);
 
-	Vertex cubeVertices[24] = {
-		// -Y
-		Vertex(-0.5f, -0.5f, -0.5f,     0.0f, -1.0f, 0.0f),
-		Vertex( 0.5f, -0.5f, -0.5f,     0.0f, -1.0f, 0.0f),
-		Vertex(-0.5f, -0.5f,  0.5f,     0.0f, -1.0f, 0.0f),
-		Vertex( 0.5f, -0.5f,  0.5f,     0.0f, -1.0f, 0.0f),
-		// -Z
-		Vertex( 0.5f, -0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
-		Vertex(-0.5f, -0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
-		Vertex( 0.5f,  0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
-		Vertex(-0.5f,  0.5f, -0.5f,     0.0f, 0.0f, -1.0f),
-		// -X
-		Vertex(-0.5f, -0.5f, -0.5f,     -1.0f, 0.0f, 0.0f),
-		Vertex(-0.5f, -0.5f,  0.5f,     -1.0f, 0.0f, 0.0f),
-		Vertex(-0.5f,  0.5f, -0.5f,     -1.0f, 0.0f, 0.0f),
-		Vertex(-0.5f,  0.5f,  0.5f,     -1.0f, 0.0f, 0.0f),
-		// +Z
-		Vertex(-0.5f, -0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
-		Vertex( 0.5f, -0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
-		Vertex(-0.5f,  0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
-		Vertex( 0.5f,  0.5f,  0.5f,     0.0f, 0.0f, 1.0f),
-		// +X
-		Vertex( 0.5f, -0.5f,  0.5f,     1.0f, 0.0f, 0.0f),
-		Vertex( 0.5f, -0.5f, -0.5f,     1.0f, 0.0f, 0.0f),
-		Vertex( 0.5f,  0.5f,  0.5f,     1.0f, 0.0f, 0.0f),
-		Vertex( 0.5f,  0.5f, -0.5f,     1.0f, 0.0f, 0.0f),
-		// +Y
-		Vertex(-0.5f,  0.5f,  0.5f,     0.0f, 1.0f, 0.0f),
-		Vertex( 0.5f,  0.5f,  0.5f,     0.0f, 1.0f, 0.0f),
-		Vertex(-0.5f,  0.5f, -0.5f,     0.0f, 1.0f, 0.0f),
-		Vertex( 0.5f,  0.5f, -0.5f,     0.0f, 1.0f, 0.0f)
-	};
-
-	GLuint cubeIndices[36] = {
-		0, 1, 2,
-		2, 1, 3,
-		4, 5, 6,
-		6, 5, 7,
-		8, 9, 10,
-		10, 9, 11,
-		12, 13, 14,
-		14, 13, 15,
-		16, 17, 18,
-		18, 17, 19,
-		20, 21, 22,
-		22, 21, 23
-	};
-
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(Vertex), &cubeVertices, GL_STATIC_DRAW);
 
@@ -248,7 +441,36 @@ void Automata3D::initRenderData() {
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 36 * sizeof(GLuint), &cubeIndices, GL_STATIC_DRAW);
+
+	// static mesh, positions feed the offset attribute so that the ramp
+	// shader's distance calculation works the same as for instances
+	glGenVertexArrays(1, &staticVao);
+	glGenBuffers(1, &staticVbo);
+	glGenBuffers(1, &staticEbo);
+
+	glBindVertexArray(staticVao);
+	glBindBuffer(GL_ARRAY_BUFFER, staticVbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, staticEbo);
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+		(void*)offsetof(Vertex, normal));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+
+	glBindVertexArray(0);
 }
 
-int Automata3D::getGeneration() { return generation; }
-ivec3 Automata3D::getSize() { return size; }
\ No newline at end of file
+const std::vector<int>& Automata3D::getChanges() const { return changes; }
+int Automata3D::getGeneration() const { return generation; }
+ivec3 Automata3D::getSize() const { return size; }
+GridView Automata3D::getGrid() const { return GridView(cells, size); }
+Automata3D Automata3D::headlessCopy() const {
+	Automata3D copy(*this);
+	copy.hasRenderData = false;
+	copy.useStaticMesh = false;
+	copy.vao = copy.vbo = copy.ebo = copy.ibo = copy.aoBuffer = 0;
+	copy.staticVao = copy.staticVbo = copy.staticEbo = 0;
+	return copy;
+}
\ No newline at end of file
@@ -1,13 +1,16 @@
 #pragma once
-#include <glad\glad.h>
-#include <GLFW\glfw3.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
 
 #include <vector>
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
+
+#include "GridView.h"
 
 using vec2 = glm::vec2;
 using vec3 = glm::vec3;
 using ivec3 = glm::ivec3;
+using uvec2 = glm::uvec2;
 using vec4 = glm::vec4;
 using mat4 = glm::mat4;
 
@@ -22,6 +25,11 @@ public:
 		glm::vec3 normal;
 	};
 
+	// the unit cube every block is drawn with, exporters reuse it so that
+	// instanced output matches the renderer
+	static const Vertex cubeVertices[24];
+	static const GLuint cubeIndices[36];
+
 public:
 	Automata3D(ivec3 size, int eL, int eU, int fL, int fU);
 	void initRenderData();
@@ -34,18 +42,51 @@ public:
 		bool omitY = false, bool omitZ = false);
 	void createCorners(int thickness);
 	void createNoise(ivec3 clusterSize);
-	int getGeneration();
-	ivec3 getSize();
+	// copies another grid into the center of this one, cropping what
+	// doesn't fit
+	void createFromGrid(GridView source);
+	// replaces the grid and generation, as when loading a saved state
+	void setState(ivec3 newSize, int newGeneration, std::vector<bool>&& newCells);
+	// flips the given cells and moves to the generation, as a step that
+	// made those changes would. Only the occlusion around them is redone
+	void applyChanges(int newGeneration, const std::vector<int>& changed);
+	// cells that flipped in the last step
+	const std::vector<int>& getChanges() const;
+	int getGeneration() const;
+	ivec3 getSize() const;
+	GridView getGrid() const;
+	// a copy of the current state without render data, which can be
+	// stepped on another thread
+	Automata3D headlessCopy() const;
 
 	int eL, eU, fL, fU;
+	// draw a greedy meshed copy of the grid instead of instanced cubes,
+	// it is only rebuilt when the cells change so it suits paused structures
+	bool useStaticMesh;
 	std::vector<bool> cells;
 	std::vector<vec3> blocks;
+	// ambient occlusion of each block, 2 bits per cube vertex
+	// vertices 0-15 are packed into x, vertices 16-23 into y
+	std::vector<uvec2> occlusion;
 
 private:
 	void rebuildInstanceArray();
+	void buildStaticMesh();
+	void rebuildOcclusion();
+	void updateOcclusion(const std::vector<int>& changes);
+	uvec2 computeOcclusion(int x, int y, int z);
 	int countNeighbors(int x, int y, int z);
+	bool isAlive(ivec3 pos);
 
-	GLuint vao, vbo, ebo, ibo;
+	GLuint vao, vbo, ebo, ibo, aoBuffer;
+	GLuint staticVao, staticVbo, staticEbo;
+	GLsizei staticIndexCount;
+	bool hasRenderData;
+	bool staticMeshDirty;
 	ivec3 size;
 	int generation;
+
+	std::vector<int> changes;
+	std::vector<uvec2> cellOcclusion;
+	std::vector<bool> occlusionDirty;
 };
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "BinaryMeshExporter.h"
+#include "GreedyMesher.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// appends the raw bytes of a value, both formats are little endian like the
+// platforms sugarcube runs on
+template<typename T>
+static void put(std::vector<char>& buffer, T value) {
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+BinaryMeshExporter::BinaryMeshExporter() {}
+
+BinaryMeshExporter::BinaryMeshExporter(GridView grid) :
+	grid(grid)
+{}
+
+void BinaryMeshExporter::load(GridView grid) {
+	this->grid = grid;
+}
+
+int BinaryMeshExporter::chunkCount(bool mergeFaces) {
+	return mergeFaces ? GreedyMesher(grid).sliceCount() : grid.size.z;
+}
+
+void BinaryMeshExporter::meshChunk(int chunk, bool mergeFaces, std::vector<Quad>& quads) {
+	if (mergeFaces) GreedyMesher(grid).meshSlice(chunk, quads);
+	else addSlabFaces(grid, chunk, quads);
+}
+
+void BinaryMeshExporter::encodeChunks(bool mergeFaces, const ChunkEncoder& encode,
+	const std::function<void(int first, int count)>& write)
+{
+	// a batch of chunks is meshed and encoded across the pool, then handed
+	// over to be written, so memory is bounded by the batch size
+	ThreadPool& pool = ThreadPool::shared();
+	int chunks = chunkCount(mergeFaces);
+	int batch = 4 * pool.size();
+	for (int first = 0; first < chunks; first += batch) {
+		int count = std::min(batch, chunks - first);
+		pool.parallelFor(first, first + count, [&](int chunk) {
+			std::vector<Quad> quads;
+			meshChunk(chunk, mergeFaces, quads);
+			encode(chunk - first, quads);
+		});
+		write(first, count);
+	}
+}
+
+bool BinaryMeshExporter::exportStl(const char* path, bool mergeFaces) {
+	TRACE_SCOPE("exportStl");
+	if (!grid.isValid()) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+
+	// 80 byte header followed by the triangle count, which is fixed up
+	// once everything has been written
+	char header[80] = "sugarcube binary stl";
+	file.write(header, sizeof(header));
+	uint32_t triangles = 0;
+	file.write(reinterpret_cast<const char*>(&triangles), sizeof(triangles));
+
+	vec3 center = vec3(grid.size) * 0.5f;
+	int batch = 4 * ThreadPool::shared().size();
+	std::vector<std::vector<char>> buffers(batch);
+
+	encodeChunks(mergeFaces, [&](int slot, const std::vector<Quad>& quads) {
+		std::vector<char>& buffer = buffers[slot];
+		buffer.clear();
+		buffer.reserve(quads.size() * 2 * 50);
+		for (const Quad& quad : quads) {
+			vec3 normal(faceNormals[quad.normal]);
+			vec3 corners[4];
+			for (int c = 0; c < 4; c++) corners[c] = vec3(quad.corners[c]) - center;
+
+			// two triangles per quad, each is a normal, three vertices and
+			// an unused attribute word
+			const int triangleCorners[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+			for (int t = 0; t < 2; t++) {
+				put(buffer, normal);
+				for (int c = 0; c < 3; c++) put(buffer, corners[triangleCorners[t][c]]);
+				put(buffer, static_cast<uint16_t>(0));
+			}
+		}
+	}, [&](int, int count) {
+		TRACE_SCOPE("write");
+		for (int i = 0; i < count; i++) {
+			if (!buffers[i].empty()) file.write(&buffers[i][0], buffers[i].size());
+			triangles += static_cast<uint32_t>(buffers[i].size() / 50);
+		}
+	});
+
+	file.seekp(sizeof(header));
+	file.write(reinterpret_cast<const char*>(&triangles), sizeof(triangles));
+	file.close();
+	return !file.fail();
+}
+
+bool BinaryMeshExporter::exportPly(const char* path, bool mergeFaces) {
+	TRACE_SCOPE("exportPly");
+	if (!grid.isValid()) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+
+	// ply wants every vertex before the first face, so faces are streamed
+	// into a temporary file next to the output and appended at the end
+	std::string facePath = std::string(path) + ".faces";
+	std::ofstream file(path, std::ios::binary);
+	std::ofstream faceFile(facePath, std::ios::binary);
+	if (!file.is_open() || !faceFile.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		if (faceFile.is_open()) {
+			faceFile.close();
+			std::remove(facePath.c_str());
+		}
+		return false;
+	}
+
+	// counts are written as fixed width placeholders and filled in later
+	const char* headerFormat =
+		"ply\n"
+		"format binary_little_endian 1.0\n"
+		"comment sugarcube export\n"
+		"element vertex %010u\n"
+		"property float x\n"
+		"property float y\n"
+		"property float z\n"
+		"property float nx\n"
+		"property float ny\n"
+		"property float nz\n"
+		"element face %010u\n"
+		"property list uchar int vertex_indices\n"
+		"end_header\n";
+	char header[512];
+	int headerLength = snprintf(header, sizeof(header), headerFormat, 0u, 0u);
+	file.write(header, headerLength);
+
+	vec3 center = vec3(grid.size) * 0.5f;
+	int batch = 4 * ThreadPool::shared().size();
+	std::vector<std::vector<char>> vertexBuffers(batch);
+	std::vector<std::vector<char>> faceBuffers(batch);
+	uint32_t vertices = 0;
+	uint32_t faces = 0;
+
+	// face indices are encoded relative to their chunk, then offset by the
+	// number of vertices written before the chunk once that is known
+	const size_t faceSize = 1 + 3 * sizeof(int32_t);
+	encodeChunks(mergeFaces, [&](int slot, const std::vector<Quad>& quads) {
+		std::vector<char>& vertexBuffer = vertexBuffers[slot];
+		std::vector<char>& faceBuffer = faceBuffers[slot];
+		vertexBuffer.clear();
+		faceBuffer.clear();
+		vertexBuffer.reserve(quads.size() * 4 * 6 * sizeof(float));
+		faceBuffer.reserve(quads.size() * 2 * faceSize);
+
+		int32_t first = 0;
+		for (const Quad& quad : quads) {
+			vec3 normal(faceNormals[quad.normal]);
+			for (int c = 0; c < 4; c++) {
+				put(vertexBuffer, vec3(quad.corners[c]) - center);
+				put(vertexBuffer, normal);
+			}
+			const int32_t triangles[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+			for (int t = 0; t < 2; t++) {
+				put(faceBuffer, static_cast<uint8_t>(3));
+				for (int c = 0; c < 3; c++) put(faceBuffer, first + triangles[t][c]);
+			}
+			first += 4;
+		}
+	}, [&](int, int count) {
+		TRACE_SCOPE("write");
+		std::vector<uint32_t> offsets(count);
+		for (int i = 0; i < count; i++) {
+			offsets[i] = vertices;
+			vertices += static_cast<uint32_t>(vertexBuffers[i].size() / (6 * sizeof(float)));
+			faces += static_cast<uint32_t>(faceBuffers[i].size() / faceSize);
+		}
+
+		ThreadPool::shared().parallelFor(0, count, [&](int i) {
+			std::vector<char>& buffer = faceBuffers[i];
+			for (size_t at = 0; at < buffer.size(); at += faceSize) {
+				for (int c = 0; c < 3; c++) {
+					char* index = &buffer[at + 1 + c * sizeof(int32_t)];
+					int32_t value;
+					std::memcpy(&value, index, sizeof(value));
+					value += offsets[i];
+					std::memcpy(index, &value, sizeof(value));
+				}
+			}
+		});
+
+		for (int i = 0; i < count; i++) {
+			if (!vertexBuffers[i].empty()) file.write(&vertexBuffers[i][0], vertexBuffers[i].size());
+			if (!faceBuffers[i].empty()) faceFile.write(&faceBuffers[i][0], faceBuffers[i].size());
+		}
+	});
+
+	// append the faces in large blocks and remove the temporary file. All
+	// of them have to come back, or the ply would end in the middle
+	faceFile.close();
+	bool facesCopied = !faceFile.fail();
+	if (facesCopied) {
+		std::ifstream faceInput(facePath, std::ios::binary);
+		std::vector<char> block(4 << 20);
+		uint64_t copied = 0;
+		while (faceInput.read(&block[0], block.size()) || faceInput.gcount() > 0) {
+			file.write(&block[0], faceInput.gcount());
+			copied += static_cast<uint64_t>(faceInput.gcount());
+		}
+		facesCopied = faceInput.eof() && !faceInput.bad() && copied == static_cast<uint64_t>(faces) * faceSize;
+	}
+	std::remove(facePath.c_str());
+	if (!facesCopied) {
+		std::cout << "Error: could not write the faces to path\n" << path << std::endl;
+		return false;
+	}
+
+	snprintf(header, sizeof(header), headerFormat, vertices, faces);
+	file.seekp(0);
+	file.write(header, headerLength);
+	file.close();
+	return !file.fail();
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#include "GridView.h"
+#include "Quad.h"
+
+using vec3 = glm::vec3;
+
+// writes the surface of the grid as binary little endian PLY or binary STL,
+// chunks of the grid are meshed and encoded into separate buffers in
+// parallel, then written out in order with large sequential writes
+class BinaryMeshExporter {
+
+public:
+	BinaryMeshExporter();
+	BinaryMeshExporter(GridView grid);
+
+	void load(GridView grid);
+	bool exportPly(const char* path, bool mergeFaces = false);
+	bool exportStl(const char* path, bool mergeFaces = false);
+
+private:
+	// a chunk is a z slab, or a greedy mesher slice when merging faces
+	using ChunkEncoder = std::function<void(int chunk, const std::vector<Quad>& quads)>;
+	int chunkCount(bool mergeFaces);
+	void meshChunk(int chunk, bool mergeFaces, std::vector<Quad>& quads);
+	void encodeChunks(bool mergeFaces, const ChunkEncoder& encode,
+		const std::function<void(int first, int count)>& write);
+
+	GridView grid;
+};
\ No newline at end of file
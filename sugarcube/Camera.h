@@ -1,6 +1,6 @@
 #pragma once
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 using mat4 = glm::mat4;
 
@@ -11,5 +11,6 @@ public:
 	virtual mat4 getProjectionMatrix(bool flipY = false) = 0;
 	virtual void setSize(float w, float h) = 0;
 	virtual void setAzimuth(float az) = 0;
+	virtual float getAzimuth() = 0;
 	virtual void setAltitude(float at) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "CellPacking.h"
+
+#include <algorithm>
+#include <cstring>
+
+// zero runs shorter than this are cheaper to keep inside a literal run
+static const size_t MIN_ZERO_RUN = 4;
+
+static void putVarint(std::vector<uint8_t>& out, size_t value) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool getVarint(const uint8_t*& data, const uint8_t* end, size_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (data == end) return false;
+		uint8_t byte = *data++;
+		value |= static_cast<size_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+void packCells(const std::vector<bool>& cells, size_t first, size_t count, uint8_t* bytes) {
+	std::memset(bytes, 0, (count + 7) / 8);
+	std::vector<bool>::const_iterator cell = cells.begin() + first;
+	for (size_t i = 0; i < count; i++, ++cell) {
+		if (*cell) bytes[i >> 3] |= static_cast<uint8_t>(1 << (i & 7));
+	}
+}
+
+void unpackCells(const uint8_t* bytes, size_t first, size_t count, std::vector<bool>& cells) {
+	std::vector<bool>::iterator cell = cells.begin() + first;
+	for (size_t i = 0; i < count; i += 8) {
+		uint8_t byte = bytes[i >> 3];
+		size_t bits = std::min<size_t>(8, count - i);
+		for (size_t bit = 0; bit < bits; bit++, ++cell) *cell = (byte >> bit) & 1;
+	}
+}
+
+void encodeZeroRuns(const uint8_t* bytes, size_t count, std::vector<uint8_t>& out) {
+	size_t at = 0;
+	while (at < count) {
+		size_t zeros = 0;
+		while (at + zeros < count && bytes[at + zeros] == 0) zeros++;
+		at += zeros;
+
+		// literals run until the next zero run that is worth encoding
+		size_t literalStart = at;
+		while (at < count) {
+			size_t run = 0;
+			while (run < MIN_ZERO_RUN && at + run < count && bytes[at + run] == 0) run++;
+			if (run == MIN_ZERO_RUN || (run > 0 && at + run == count)) break;
+			at += std::max<size_t>(run, 1);
+		}
+
+		putVarint(out, zeros);
+		putVarint(out, at - literalStart);
+		out.insert(out.end(), bytes + literalStart, bytes + at);
+	}
+}
+
+bool decodeZeroRuns(const uint8_t* data, size_t size, uint8_t* bytes, size_t count) {
+	const uint8_t* end = data + size;
+	size_t at = 0;
+	while (data < end) {
+		size_t zeros, literals;
+		if (!getVarint(data, end, zeros) || !getVarint(data, end, literals)) return false;
+		if (zeros > count - at || literals > count - at - zeros) return false;
+		if (literals > static_cast<size_t>(end - data)) return false;
+		std::memset(bytes + at, 0, zeros);
+		at += zeros;
+		std::memcpy(bytes + at, data, literals);
+		at += literals;
+		data += literals;
+	}
+	// trailing zeros are implied
+	std::memset(bytes + at, 0, count - at);
+	return true;
+}
+
+void encodeChangeList(std::vector<int> changes, std::vector<uint8_t>& out) {
+	std::sort(changes.begin(), changes.end());
+	size_t previous = 0;
+	for (int change : changes) {
+		putVarint(out, static_cast<size_t>(change) - previous);
+		previous = static_cast<size_t>(change);
+	}
+}
+
+bool applyChangeList(const uint8_t* data, size_t size, std::vector<bool>& cells) {
+	const uint8_t* end = data + size;
+	size_t index = 0;
+	while (data < end) {
+		size_t gap;
+		if (!getVarint(data, end, gap) || gap >= cells.size() - index) return false;
+		index += gap;
+		cells[index].flip();
+	}
+	return true;
+}
+
+bool decodeChangeList(const uint8_t* data, size_t size, size_t cellCount, std::vector<int>& changes) {
+	const uint8_t* end = data + size;
+	size_t index = 0;
+	changes.clear();
+	while (data < end) {
+		size_t gap;
+		if (!getVarint(data, end, gap) || gap >= cellCount - index) return false;
+		index += gap;
+		changes.push_back(static_cast<int>(index));
+	}
+	return true;
+}
\ No newline at end of file
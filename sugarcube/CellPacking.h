@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// cells are packed 8 to a byte, cell i is bit i % 8 of byte i / 8
+
+void packCells(const std::vector<bool>& cells, size_t first, size_t count, uint8_t* bytes);
+void unpackCells(const uint8_t* bytes, size_t first, size_t count, std::vector<bool>& cells);
+
+// zero run encoding of packed bytes, a sequence of (zero byte count,
+// literal byte count, literal bytes) with both counts as varints. Sparse
+// grids shrink to little more than their live bytes
+void encodeZeroRuns(const uint8_t* bytes, size_t count, std::vector<uint8_t>& out);
+// returns false if the data is malformed or doesn't decode to count bytes
+bool decodeZeroRuns(const uint8_t* data, size_t size, uint8_t* bytes, size_t count);
+
+// change lists hold the indices of cells that flipped, sorted and stored as
+// varint gaps. Applying one flips those cells again
+void encodeChangeList(std::vector<int> changes, std::vector<uint8_t>& out);
+bool applyChangeList(const uint8_t* data, size_t size, std::vector<bool>& cells);
+// reads the indices back out of a change list for a grid of cellCount cells
+bool decodeChangeList(const uint8_t* data, size_t size, size_t cellCount, std::vector<int>& changes);
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "Checkpoint.h"
+#include "CellPacking.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char MAGIC[4] = { 'S', 'G', 'C', 'P' };
+
+Checkpoint::Checkpoint() :
+	size(0),
+	generation(1),
+	eL(0), eU(0), fL(0), fU(0),
+	index(nullptr),
+	chunks(0)
+{}
+
+bool Checkpoint::save(const char* path, const Automata3D& simulation, bool compress) {
+	TRACE_SCOPE("saveCheckpoint");
+	GridView grid = simulation.getGrid();
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+
+	size_t cells = grid.cells->size();
+	uint32_t chunkCount = static_cast<uint32_t>((cells + CHUNK_CELLS - 1) / CHUNK_CELLS);
+	Header header = {
+		{ MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3] }, VERSION,
+		{ grid.size.x, grid.size.y, grid.size.z }, simulation.getGeneration(),
+		{ simulation.eL, simulation.eU, simulation.fL, simulation.fU },
+		CHUNK_CELLS, chunkCount
+	};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	// the index is written again once the chunk sizes are known
+	std::vector<ChunkEntry> entries(chunkCount);
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+	uint64_t offset = sizeof(Header) + chunkCount * sizeof(ChunkEntry);
+
+	// chunks are packed and encoded in parallel a batch at a time, then
+	// written in order
+	ThreadPool& pool = ThreadPool::shared();
+	int batch = 4 * pool.size();
+	std::vector<std::vector<uint8_t>> buffers(batch);
+	for (int first = 0; first < static_cast<int>(chunkCount); first += batch) {
+		int count = std::min(batch, static_cast<int>(chunkCount) - first);
+		pool.parallelFor(first, first + count, [&](int chunk) {
+			size_t begin = static_cast<size_t>(chunk) * CHUNK_CELLS;
+			size_t length = std::min<size_t>(CHUNK_CELLS, cells - begin);
+			std::vector<uint8_t> packed((length + 7) / 8);
+			packCells(*grid.cells, begin, length, packed.data());
+
+			std::vector<uint8_t>& out = buffers[chunk - first];
+			out.clear();
+			ChunkEntry& entry = entries[chunk];
+			if (std::all_of(packed.begin(), packed.end(), [](uint8_t byte) { return byte == 0; })) {
+				entry.encoding = Empty;
+				return;
+			}
+			if (compress) {
+				encodeZeroRuns(packed.data(), packed.size(), out);
+				if (out.size() < packed.size()) {
+					entry.encoding = ZeroRuns;
+					return;
+				}
+			}
+			out.swap(packed);
+			entry.encoding = Raw;
+		});
+
+		for (int i = 0; i < count; i++) {
+			ChunkEntry& entry = entries[first + i];
+			entry.offset = offset;
+			entry.bytes = static_cast<uint32_t>(buffers[i].size());
+			file.write(reinterpret_cast<const char*>(buffers[i].data()), buffers[i].size());
+			offset += buffers[i].size();
+		}
+	}
+
+	file.seekp(sizeof(Header));
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+	file.close();
+	return !file.fail();
+}
+
+bool Checkpoint::open(const char* path) {
+	close();
+	if (!file.open(path)) {
+		std::cout << "Error: could not open file\n" << path << std::endl;
+		return false;
+	}
+
+	Header header;
+	if (file.size < sizeof(header)) {
+		std::cout << "Error: not a checkpoint file\n" << path << std::endl;
+		close();
+		return false;
+	}
+	std::memcpy(&header, file.data, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, 4) != 0) {
+		std::cout << "Error: not a checkpoint file\n" << path << std::endl;
+		close();
+		return false;
+	}
+	if (header.version > VERSION) {
+		std::cout << "Error: checkpoint version " << header.version <<
+			" is newer than this build supports\n" << path << std::endl;
+		close();
+		return false;
+	}
+
+	size = ivec3(header.size[0], header.size[1], header.size[2]);
+	generation = header.generation;
+	eL = header.rule[0];
+	eU = header.rule[1];
+	fL = header.rule[2];
+	fU = header.rule[3];
+	chunks = header.chunkCount;
+	// restoring indexes cells with an int, and the chunk count below is
+	// only meaningful when the cell count doesn't wrap
+	if (glm::any(glm::lessThan(size, ivec3(1))) ||
+		static_cast<int64_t>(size.x) * size.y * size.z > INT_MAX)
+	{
+		std::cout << "Error: the checkpoint has an invalid grid size\n" << path << std::endl;
+		close();
+		return false;
+	}
+	size_t expected = (cellCount() + CHUNK_CELLS - 1) / CHUNK_CELLS;
+	if (header.chunkCells != CHUNK_CELLS || chunks != expected || file.size < sizeof(Header) + chunks * sizeof(ChunkEntry))
+	{
+		std::cout << "Error: checkpoint is damaged\n" << path << std::endl;
+		close();
+		return false;
+	}
+	index = reinterpret_cast<const ChunkEntry*>(file.data + sizeof(Header));
+	return true;
+}
+
+void Checkpoint::close() {
+	file.close();
+	index = nullptr;
+	chunks = 0;
+}
+
+int Checkpoint::chunkCount() const {
+	return static_cast<int>(chunks);
+}
+
+size_t Checkpoint::cellCount() const {
+	return static_cast<size_t>(size.x) * size.y * size.z;
+}
+
+bool Checkpoint::decodeChunk(int chunk, std::vector<bool>& cells) const {
+	if (!index || chunk < 0 || chunk >= chunkCount() || cells.size() != cellCount()) return false;
+
+	ChunkEntry entry;
+	std::memcpy(&entry, &index[chunk], sizeof(entry));
+	// checked without adding, so a huge offset can't wrap around
+	if (entry.offset > file.size || entry.bytes > file.size - entry.offset) return false;
+
+	size_t begin = static_cast<size_t>(chunk) * CHUNK_CELLS;
+	size_t length = std::min<size_t>(CHUNK_CELLS, cells.size() - begin);
+	if (entry.encoding == Empty) {
+		std::fill(cells.begin() + begin, cells.begin() + begin + length, false);
+		return true;
+	}
+
+	const uint8_t* data = file.data + entry.offset;
+	size_t packedBytes = (length + 7) / 8;
+	if (entry.encoding == Raw) {
+		if (entry.bytes != packedBytes) return false;
+		unpackCells(data, begin, length, cells);
+		return true;
+	}
+	if (entry.encoding == ZeroRuns) {
+		std::vector<uint8_t> packed(packedBytes);
+		if (!decodeZeroRuns(data, entry.bytes, packed.data(), packed.size())) return false;
+		unpackCells(packed.data(), begin, length, cells);
+		return true;
+	}
+	return false;
+}
+
+bool Checkpoint::decodeAll(std::vector<bool>& cells) const {
+	TRACE_SCOPE("decodeCheckpoint");
+	cells.assign(cellCount(), false);
+	std::atomic<bool> valid(true);
+	ThreadPool::shared().parallelFor(0, chunkCount(), [&](int chunk) {
+		if (!decodeChunk(chunk, cells)) valid = false;
+	});
+	return valid;
+}
+
+bool Checkpoint::restore(Automata3D& simulation) const {
+	std::vector<bool> cells;
+	if (!decodeAll(cells)) {
+		std::cout << "Error: checkpoint is damaged" << std::endl;
+		return false;
+	}
+	simulation.eL = eL;
+	simulation.eU = eU;
+	simulation.fL = fL;
+	simulation.fU = fU;
+	simulation.setState(size, generation, std::move(cells));
+	return true;
+}
\ No newline at end of file
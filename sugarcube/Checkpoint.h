@@ -0,0 +1,71 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Automata3D.h"
+#include "MappedFile.h"
+
+using ivec3 = glm::ivec3;
+
+// versioned save file of a simulation: size, generation, rule and the grid
+// packed to one bit per cell. The grid is split into chunks that are each
+// stored raw or zero run encoded, whichever is smaller, and an index of the
+// chunks follows the header. Loading maps the file and only decodes the
+// chunks that are asked for
+class Checkpoint {
+
+public:
+	static const uint32_t VERSION = 1;
+	// a multiple of the word size of std::vector<bool>, so that chunks can
+	// be decoded into the same grid from several threads
+	static const uint32_t CHUNK_CELLS = 1 << 20;
+
+	Checkpoint();
+
+	static bool save(const char* path, const Automata3D& simulation, bool compress = true);
+
+	bool open(const char* path);
+	void close();
+	int chunkCount() const;
+	// cells must already hold size.x * size.y * size.z values
+	bool decodeChunk(int chunk, std::vector<bool>& cells) const;
+	bool decodeAll(std::vector<bool>& cells) const;
+	// replaces the simulation's size, generation, rule and cells
+	bool restore(Automata3D& simulation) const;
+
+	ivec3 size;
+	int generation;
+	int eL, eU, fL, fU;
+
+private:
+	enum ChunkEncoding : uint32_t {
+		Raw,
+		ZeroRuns,
+		// every cell is dead, nothing is stored
+		Empty
+	};
+
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		int32_t size[3];
+		int32_t generation;
+		int32_t rule[4];
+		uint32_t chunkCells;
+		uint32_t chunkCount;
+	};
+
+	struct ChunkEntry {
+		uint64_t offset;
+		uint32_t bytes;
+		uint32_t encoding;
+	};
+
+	size_t cellCount() const;
+
+	MappedFile file;
+	const ChunkEntry* index;
+	uint32_t chunks;
+};
\ No newline at end of file
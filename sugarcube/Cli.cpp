@@ -0,0 +1,218 @@
+#include "Cli.h"
+#include "Automata3D.h"
+#include "BinaryMeshExporter.h"
+#include "Checkpoint.h"
+#include "GLContext.h"
+#include "ObjExporter.h"
+#include "OrthoCamera.h"
+#include "RunArchive.h"
+#include "Sugarcube.h"
+#include "VoxFile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// reads count comma separated integers, a single value is repeated when
+// repeat is set
+static bool parseInts(const std::string& text, int* values, int count, bool repeat = false) {
+	std::stringstream stream(text);
+	std::string item;
+	int read = 0;
+	while (std::getline(stream, item, ',')) {
+		if (read == count) return false;
+		try {
+			values[read++] = std::stoi(item);
+		}
+		catch (...) {
+			return false;
+		}
+	}
+	if (read == 1 && repeat) {
+		std::fill(values + 1, values + count, values[0]);
+		return true;
+	}
+	return read == count;
+}
+
+int runReplay(int argc, char** argv) {
+	if (argc < 1) {
+		std::cout << "Usage: sugarcube --replay <archive> [--from G] [--to G] [--checkpoint <path>]" << std::endl;
+		return 1;
+	}
+
+	ArchiveReader archive;
+	if (!archive.open(argv[0])) return 1;
+
+	int from = archive.firstGeneration();
+	int to = archive.lastGeneration();
+	const char* checkpointPath = nullptr;
+	for (int i = 1; i < argc; i += 2) {
+		std::string option = argv[i];
+		if (i + 1 >= argc) {
+			std::cout << "Missing value for " << option << std::endl;
+			return 1;
+		}
+		std::string value = argv[i + 1];
+
+		bool valid = true;
+		if (option == "--from") valid = parseInts(value, &from, 1);
+		else if (option == "--to") valid = parseInts(value, &to, 1);
+		else if (option == "--checkpoint") checkpointPath = argv[i + 1];
+		else {
+			std::cout << "Unknown option " << option << std::endl;
+			return 1;
+		}
+		if (!valid) {
+			std::cout << "Invalid value " << value << " for " << option << std::endl;
+			return 1;
+		}
+	}
+	from = std::max(from, archive.firstGeneration());
+	to = std::min(to, archive.lastGeneration());
+
+	// one seek to the start, then a single record per generation
+	std::vector<bool> cells;
+	std::cout << "generation,population" << std::endl;
+	for (int generation = from; generation <= to; generation++) {
+		bool read = generation == from ?
+			archive.seek(generation, cells) : archive.advance(generation, cells);
+		if (!read) {
+			std::cout << "Error: could not read generation " << generation << std::endl;
+			return 1;
+		}
+		std::cout << generation << "," << std::count(cells.begin(), cells.end(), true) << std::endl;
+	}
+
+	if (checkpointPath && from <= to) {
+		Automata3D simulation(archive.size, archive.eL, archive.eU, archive.fL, archive.fU);
+		simulation.setState(archive.size, to, std::move(cells));
+		if (!Checkpoint::save(checkpointPath, simulation)) return 1;
+	}
+	return 0;
+}
+
+int runBatch(int argc, char** argv) {
+	ivec3 size(16);
+	int rule[4] = { 4, 5, 2, 6 };
+	std::string shape = "box";
+	int shapeSize[3] = { 0, 0, 0 };
+	bool hasShapeSize = false;
+	bool omit[3] = { false, false, false };
+	const char* voxPath = nullptr;
+	int seed = static_cast<int>(time(NULL));
+	int generations = 0;
+	const char* checkpointPath = nullptr;
+	const char* objPath = nullptr;
+	const char* plyPath = nullptr;
+	const char* stlPath = nullptr;
+	bool mergeFaces = false;
+	const char* imagePath = nullptr;
+	int imageSize[2] = { 1024, 1024 };
+	int supersample = 1;
+	ContextBackend backend = ContextBackend::Auto;
+
+	for (int i = 0; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--merge") {
+			mergeFaces = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			std::cout << "Missing value for " << option << std::endl;
+			return 1;
+		}
+		std::string value = argv[++i];
+
+		bool valid = true;
+		if (option == "--size") valid = parseInts(value, &size.x, 3, true);
+		else if (option == "--rule") valid = parseInts(value, rule, 4);
+		else if (option == "--shape") shape = value;
+		else if (option == "--shape-size") valid = hasShapeSize = parseInts(value, shapeSize, 3, true);
+		else if (option == "--omit") {
+			for (char axis : value) {
+				if (axis < 'x' || axis > 'z') valid = false;
+				else omit[axis - 'x'] = true;
+			}
+		}
+		else if (option == "--vox") voxPath = argv[i];
+		else if (option == "--seed") valid = parseInts(value, &seed, 1);
+		else if (option == "--generations") valid = parseInts(value, &generations, 1);
+		else if (option == "--checkpoint") checkpointPath = argv[i];
+		else if (option == "--obj") objPath = argv[i];
+		else if (option == "--ply") plyPath = argv[i];
+		else if (option == "--stl") stlPath = argv[i];
+		else if (option == "--image") imagePath = argv[i];
+		else if (option == "--image-size") valid = parseInts(value, imageSize, 2, true);
+		else if (option == "--supersample") valid = parseInts(value, &supersample, 1);
+		else if (option == "--context") valid = GLContext::parseBackend(value, backend);
+		else {
+			std::cout << "Unknown option " << option << std::endl;
+			return 1;
+		}
+		if (!valid) {
+			std::cout << "Invalid value " << value << " for " << option << std::endl;
+			return 1;
+		}
+	}
+	if (size.x < 1 || size.y < 1 || size.z < 1) {
+		std::cout << "The grid size must be positive" << std::endl;
+		return 1;
+	}
+
+	// the simulation never gets render data, so it doesn't need a context
+	Automata3D simulation(size, rule[0], rule[1], rule[2], rule[3]);
+	srand(static_cast<unsigned int>(seed));
+	if (shape == "box") simulation.createBox(hasShapeSize ? ivec3(shapeSize[0], shapeSize[1], shapeSize[2]) : ivec3(2));
+	else if (shape == "cross") simulation.createCross(hasShapeSize ? shapeSize[0] : 2, omit[0], omit[1], omit[2]);
+	else if (shape == "corners") simulation.createCorners(hasShapeSize ? shapeSize[0] : 2);
+	else if (shape == "noise") simulation.createNoise(hasShapeSize ? ivec3(shapeSize[0], shapeSize[1], shapeSize[2]) : ivec3(8));
+	else if (shape == "vox") {
+		std::vector<bool> cells;
+		ivec3 voxSize;
+		if (!voxPath || !VoxFile::read(voxPath, cells, voxSize)) {
+			std::cout << "The vox shape needs a readable --vox file" << std::endl;
+			return 1;
+		}
+		simulation.createFromGrid(GridView(cells, voxSize));
+	}
+	else {
+		std::cout << "Unknown shape " << shape << std::endl;
+		return 1;
+	}
+
+	for (int i = 0; i < generations; i++) simulation.step();
+
+	GridView grid = simulation.getGrid();
+	std::cout << "generation,population" << std::endl;
+	std::cout << simulation.getGeneration() << "," << std::count(grid.cells->begin(), grid.cells->end(), true) << std::endl;
+
+	bool failed = false;
+	if (checkpointPath && !Checkpoint::save(checkpointPath, simulation)) failed = true;
+	if (objPath && !ObjExporter(grid).exportObj(mergeFaces, objPath)) failed = true;
+	if (plyPath && !BinaryMeshExporter(grid).exportPly(plyPath, mergeFaces)) failed = true;
+	if (stlPath && !BinaryMeshExporter(grid).exportStl(stlPath, mergeFaces)) failed = true;
+
+	if (imagePath) {
+		GLContext context;
+		if (!context.create(backend)) return 1;
+		{
+			// zoomed so the whole grid fits in the image
+			OrthoCamera camera(nullptr, static_cast<float>(imageSize[0]), static_cast<float>(imageSize[1]));
+			float aspect = std::min(1.0f, static_cast<float>(imageSize[0]) / imageSize[1]);
+			camera.zoom = aspect / (glm::length(static_cast<vec3>(size)) * 1.05f);
+
+			Sugarcube renderer(static_cast<float>(imageSize[0]), static_cast<float>(imageSize[1]), 0.0f);
+			renderer.camera = &camera;
+			renderer.initialize();
+			renderer.loadSimulation(simulation);
+			if (!renderer.renderImage(imagePath, ivec2(imageSize[0], imageSize[1]), supersample)) failed = true;
+			renderer.shutdown();
+		}
+		context.destroy();
+	}
+	return failed ? 1 : 0;
+}
\ No newline at end of file
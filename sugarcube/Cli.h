@@ -0,0 +1,20 @@
+#pragma once
+
+// command line modes that run without opening a window
+
+// sugarcube --replay <archive> [--from G] [--to G] [--checkpoint <path>]
+// prints the population of each generation of a run archive as csv and
+// optionally saves the last replayed generation as a checkpoint
+int runReplay(int argc, char** argv);
+
+// sugarcube --batch [options]
+// runs one simulation to a given generation without a window and writes
+// the requested outputs. A GL context is only created for --image, by
+// default without a window system when the build supports it
+//   --size N|X,Y,Z  --rule eL,eU,fL,fU
+//   --shape box|cross|corners|noise|vox  --shape-size N|X,Y,Z
+//   --omit xyz  --vox <file>  --seed N  --generations N
+//   --checkpoint <path>  --obj <path>  --ply <path>  --stl <path>  --merge
+//   --image <path>  --image-size W,H  --supersample N
+//   --context auto|hidden|egl|osmesa
+int runBatch(int argc, char** argv);
\ No newline at end of file
@@ -0,0 +1,470 @@
+#include "Deflate.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+static const uint32_t ADLER_MOD = 65521;
+static const int WINDOW = 1 << 15;
+static const int HASH_BITS = 15;
+static const int MIN_MATCH = 3;
+static const int MAX_MATCH = 258;
+// matches of the minimum length further back than this cost more than
+// the literals they replace
+static const int FAR_MIN_MATCH = 4096;
+// tokens per block, each block gets its own huffman codes
+static const size_t BLOCK_TOKENS = 1 << 15;
+static const size_t MAX_STORED = 65535;
+static const int END_OF_BLOCK = 256;
+
+static const uint16_t LENGTH_BASE[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t CODE_LENGTH_ORDER[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+// extra bits of the code length symbols 16, 17 and 18
+static const uint8_t CODE_LENGTH_EXTRA[3] = { 2, 3, 7 };
+
+// how hard each level looks for matches: the number of earlier positions
+// tried, the length that is good enough to stop at, and whether a match
+// is put off by a byte when the next one is longer
+struct MatchLevel {
+	int chain;
+	int nice;
+	bool lazy;
+};
+
+static const MatchLevel LEVELS[10] = {
+	{ 0, 0, false },
+	{ 4, 8, false },
+	{ 8, 16, false },
+	{ 16, 32, false },
+	{ 16, 32, true },
+	{ 32, 64, true },
+	{ 128, 128, true },
+	{ 256, MAX_MATCH, true },
+	{ 1024, MAX_MATCH, true },
+	{ 4096, MAX_MATCH, true }
+};
+
+// literals are stored with a distance of 0 and the byte in length
+struct Token {
+	uint16_t length;
+	uint16_t distance;
+};
+
+struct Huffman {
+	std::vector<uint8_t> lengths;
+	// bit reversed, deflate writes codes from their most significant bit
+	std::vector<uint16_t> codes;
+};
+
+class BitWriter {
+
+public:
+	BitWriter(std::vector<uint8_t>& out) : out(out), bits(0), count(0) {}
+
+	void put(uint32_t value, int length) {
+		bits |= static_cast<uint64_t>(value) << count;
+		count += length;
+		while (count >= 8) {
+			out.push_back(static_cast<uint8_t>(bits));
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void align() {
+		if (count > 0) out.push_back(static_cast<uint8_t>(bits));
+		bits = 0;
+		count = 0;
+	}
+
+	std::vector<uint8_t>& out;
+
+private:
+	uint64_t bits;
+	int count;
+};
+
+static uint16_t reverseBits(uint32_t code, int length) {
+	uint32_t reversed = 0;
+	for (int i = 0; i < length; i++) {
+		reversed = (reversed << 1) | (code & 1);
+		code >>= 1;
+	}
+	return static_cast<uint16_t>(reversed);
+}
+
+static void buildCodes(Huffman& huffman) {
+	int counts[16] = {};
+	for (uint8_t length : huffman.lengths) if (length) counts[length]++;
+	int next[16] = {};
+	int code = 0;
+	for (int bits = 1; bits < 16; bits++) {
+		code = (code + counts[bits - 1]) << 1;
+		next[bits] = code;
+	}
+	huffman.codes.assign(huffman.lengths.size(), 0);
+	for (size_t i = 0; i < huffman.lengths.size(); i++) {
+		int length = huffman.lengths[i];
+		if (length) huffman.codes[i] = reverseBits(next[length]++, length);
+	}
+}
+
+// huffman code lengths no longer than limit. When the tree gets too deep
+// the frequencies are flattened and it is built again
+static void buildHuffman(std::vector<uint32_t> frequencies, int limit, Huffman& huffman) {
+	size_t count = frequencies.size();
+	huffman.lengths.assign(count, 0);
+
+	// a complete code needs at least two symbols
+	size_t used = std::count_if(frequencies.begin(), frequencies.end(), [](uint32_t f) { return f > 0; });
+	for (size_t i = 0; used < 2 && i < count; i++) {
+		if (frequencies[i] == 0) {
+			frequencies[i] = 1;
+			used++;
+		}
+	}
+
+	typedef std::pair<uint32_t, int> Node;
+	while (true) {
+		// leaves come first, every merged node is added after its children
+		std::vector<int> parent(count, -1);
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+		for (size_t i = 0; i < count; i++)
+			if (frequencies[i]) queue.push(Node(frequencies[i], static_cast<int>(i)));
+		while (queue.size() > 1) {
+			Node a = queue.top();
+			queue.pop();
+			Node b = queue.top();
+			queue.pop();
+			int node = static_cast<int>(parent.size());
+			parent.push_back(-1);
+			parent[a.second] = node;
+			parent[b.second] = node;
+			queue.push(Node(a.first + b.first, node));
+		}
+
+		std::vector<int> depth(parent.size(), 0);
+		for (int node = static_cast<int>(parent.size()) - 1; node >= 0; node--)
+			if (parent[node] >= 0) depth[node] = depth[parent[node]] + 1;
+
+		int longest = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (!frequencies[i]) continue;
+			huffman.lengths[i] = static_cast<uint8_t>(depth[i]);
+			longest = std::max(longest, depth[i]);
+		}
+		if (longest <= limit) break;
+		for (uint32_t& f : frequencies) if (f) f = (f >> 1) | 1;
+	}
+	buildCodes(huffman);
+}
+
+// symbol lookups for match lengths and distances
+struct SymbolTables {
+	uint8_t length[MAX_MATCH + 1];
+	// distances up to 256 are looked up directly, longer ones by (d - 1) / 128
+	uint8_t distance[512];
+	Huffman fixedLiterals;
+	Huffman fixedDistances;
+
+	SymbolTables() {
+		for (int symbol = 0; symbol < 29; symbol++)
+			for (int l = LENGTH_BASE[symbol]; l < LENGTH_BASE[symbol] + (1 << LENGTH_EXTRA[symbol]) && l <= MAX_MATCH; l++)
+				length[l] = static_cast<uint8_t>(symbol);
+		for (int symbol = 0; symbol < 30; symbol++) {
+			for (int d = DISTANCE_BASE[symbol]; d < DISTANCE_BASE[symbol] + (1 << DISTANCE_EXTRA[symbol]); d++) {
+				if (d <= 256) distance[d - 1] = static_cast<uint8_t>(symbol);
+				else distance[256 + ((d - 1) >> 7)] = static_cast<uint8_t>(symbol);
+			}
+		}
+
+		fixedLiterals.lengths.resize(288);
+		for (int i = 0; i < 288; i++) fixedLiterals.lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+		fixedDistances.lengths.assign(30, 5);
+		buildCodes(fixedLiterals);
+		buildCodes(fixedDistances);
+	}
+
+	int distanceSymbol(int d) const {
+		return d <= 256 ? distance[d - 1] : distance[256 + ((d - 1) >> 7)];
+	}
+};
+
+static const SymbolTables& symbolTables() {
+	static const SymbolTables tables;
+	return tables;
+}
+
+static size_t tokenBits(const std::vector<Token>& tokens, const Huffman& literals, const Huffman& distances) {
+	const SymbolTables& tables = symbolTables();
+	size_t bits = literals.lengths[END_OF_BLOCK];
+	for (const Token& token : tokens) {
+		if (token.distance == 0) {
+			bits += literals.lengths[token.length];
+			continue;
+		}
+		int lengthSymbol = tables.length[token.length];
+		int distanceSymbol = tables.distanceSymbol(token.distance);
+		bits += literals.lengths[257 + lengthSymbol] + LENGTH_EXTRA[lengthSymbol];
+		bits += distances.lengths[distanceSymbol] + DISTANCE_EXTRA[distanceSymbol];
+	}
+	return bits;
+}
+
+static void writeTokens(BitWriter& writer, const std::vector<Token>& tokens,
+	const Huffman& literals, const Huffman& distances)
+{
+	const SymbolTables& tables = symbolTables();
+	for (const Token& token : tokens) {
+		if (token.distance == 0) {
+			writer.put(literals.codes[token.length], literals.lengths[token.length]);
+			continue;
+		}
+		int lengthSymbol = tables.length[token.length];
+		writer.put(literals.codes[257 + lengthSymbol], literals.lengths[257 + lengthSymbol]);
+		writer.put(token.length - LENGTH_BASE[lengthSymbol], LENGTH_EXTRA[lengthSymbol]);
+		int distanceSymbol = tables.distanceSymbol(token.distance);
+		writer.put(distances.codes[distanceSymbol], distances.lengths[distanceSymbol]);
+		writer.put(token.distance - DISTANCE_BASE[distanceSymbol], DISTANCE_EXTRA[distanceSymbol]);
+	}
+	writer.put(literals.codes[END_OF_BLOCK], literals.lengths[END_OF_BLOCK]);
+}
+
+static void writeStored(BitWriter& writer, const uint8_t* data, size_t size) {
+	for (size_t offset = 0; offset < size; offset += MAX_STORED) {
+		size_t length = std::min(MAX_STORED, size - offset);
+		writer.put(0, 3);
+		writer.align();
+		writer.put(static_cast<uint32_t>(length), 16);
+		writer.put(static_cast<uint32_t>(~length & 0xFFFF), 16);
+		writer.out.insert(writer.out.end(), data + offset, data + offset + length);
+	}
+}
+
+// writes the tokens as whichever of a dynamic, fixed or stored block is
+// smallest, data is the input the tokens were made from
+static void writeBlock(BitWriter& writer, const std::vector<Token>& tokens, const uint8_t* data, size_t size) {
+	const SymbolTables& tables = symbolTables();
+	std::vector<uint32_t> literalCounts(286, 0), distanceCounts(30, 0);
+	literalCounts[END_OF_BLOCK] = 1;
+	for (const Token& token : tokens) {
+		if (token.distance == 0) {
+			literalCounts[token.length]++;
+			continue;
+		}
+		literalCounts[257 + tables.length[token.length]]++;
+		distanceCounts[tables.distanceSymbol(token.distance)]++;
+	}
+	Huffman literals, distances;
+	buildHuffman(literalCounts, 15, literals);
+	buildHuffman(distanceCounts, 15, distances);
+
+	int literalCount = 286;
+	while (literalCount > 257 && literals.lengths[literalCount - 1] == 0) literalCount--;
+	int distanceCount = 30;
+	while (distanceCount > 1 && distances.lengths[distanceCount - 1] == 0) distanceCount--;
+
+	// both code length lists are sent as one, with runs of repeated lengths
+	// and zeros shortened by the symbols 16, 17 and 18
+	std::vector<uint8_t> lengths(literals.lengths.begin(), literals.lengths.begin() + literalCount);
+	lengths.insert(lengths.end(), distances.lengths.begin(), distances.lengths.begin() + distanceCount);
+	std::vector<std::pair<uint8_t, uint8_t>> runs;
+	for (size_t i = 0; i < lengths.size();) {
+		uint8_t length = lengths[i];
+		size_t run = 1;
+		while (i + run < lengths.size() && lengths[i + run] == length) run++;
+		i += run;
+
+		size_t left = run;
+		if (length == 0) {
+			while (left >= 11) {
+				size_t repeat = std::min<size_t>(left, 138);
+				runs.push_back(std::make_pair(18, static_cast<uint8_t>(repeat - 11)));
+				left -= repeat;
+			}
+			if (left >= 3) {
+				runs.push_back(std::make_pair(17, static_cast<uint8_t>(left - 3)));
+				left = 0;
+			}
+		}
+		else {
+			runs.push_back(std::make_pair(length, 0));
+			left--;
+			while (left >= 3) {
+				size_t repeat = std::min<size_t>(left, 6);
+				runs.push_back(std::make_pair(16, static_cast<uint8_t>(repeat - 3)));
+				left -= repeat;
+			}
+		}
+		for (; left > 0; left--) runs.push_back(std::make_pair(length, 0));
+	}
+
+	std::vector<uint32_t> codeLengthCounts(19, 0);
+	for (const auto& run : runs) codeLengthCounts[run.first]++;
+	Huffman codeLengths;
+	buildHuffman(codeLengthCounts, 7, codeLengths);
+	int codeLengthCount = 19;
+	while (codeLengthCount > 4 && codeLengths.lengths[CODE_LENGTH_ORDER[codeLengthCount - 1]] == 0) codeLengthCount--;
+
+	size_t dynamicBits = 3 + 14 + 3 * codeLengthCount + tokenBits(tokens, literals, distances);
+	for (const auto& run : runs)
+		dynamicBits += codeLengths.lengths[run.first] + (run.first >= 16 ? CODE_LENGTH_EXTRA[run.first - 16] : 0);
+	size_t fixedBits = 3 + tokenBits(tokens, tables.fixedLiterals, tables.fixedDistances);
+	size_t storedBits = ((size + MAX_STORED - 1) / MAX_STORED) * (3 + 7 + 32) + 8 * size;
+
+	if (storedBits < dynamicBits && storedBits < fixedBits) {
+		writeStored(writer, data, size);
+	}
+	else if (fixedBits <= dynamicBits) {
+		writer.put(1 << 1, 3);
+		writeTokens(writer, tokens, tables.fixedLiterals, tables.fixedDistances);
+	}
+	else {
+		writer.put(2 << 1, 3);
+		writer.put(literalCount - 257, 5);
+		writer.put(distanceCount - 1, 5);
+		writer.put(codeLengthCount - 4, 4);
+		for (int i = 0; i < codeLengthCount; i++) writer.put(codeLengths.lengths[CODE_LENGTH_ORDER[i]], 3);
+		for (const auto& run : runs) {
+			writer.put(codeLengths.codes[run.first], codeLengths.lengths[run.first]);
+			if (run.first >= 16) writer.put(run.second, CODE_LENGTH_EXTRA[run.first - 16]);
+		}
+		writeTokens(writer, tokens, literals, distances);
+	}
+}
+
+void deflatePiece(const uint8_t* data, size_t size, int level, std::vector<uint8_t>& out) {
+	BitWriter writer(out);
+	level = std::max(0, std::min(level, 9));
+
+	if (level == 0) writeStored(writer, data, size);
+	else {
+		const MatchLevel& params = LEVELS[level];
+
+		// chains of earlier positions with the same first three bytes
+		std::vector<int32_t> head(1 << HASH_BITS, -1);
+		std::vector<int32_t> previous(WINDOW, -1);
+		auto hash = [&](size_t i) {
+			uint32_t bytes = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+			return (bytes * 2654435761u) >> (32 - HASH_BITS);
+		};
+		auto insert = [&](size_t i) {
+			if (i + MIN_MATCH > size) return;
+			uint32_t h = hash(i);
+			previous[i & (WINDOW - 1)] = head[h];
+			head[h] = static_cast<int32_t>(i);
+		};
+		auto findMatch = [&](size_t i, int& distance) {
+			if (i + MIN_MATCH > size) return 0;
+			int best = 0;
+			int maxLength = static_cast<int>(std::min<size_t>(MAX_MATCH, size - i));
+			int chain = params.chain;
+			const uint8_t* current = data + i;
+			for (int32_t j = head[hash(i)]; j >= 0 && chain-- > 0; j = previous[j & (WINDOW - 1)]) {
+				if (static_cast<int>(i - j) > WINDOW) break;
+				const uint8_t* candidate = data + j;
+				if (candidate[best] != current[best]) continue;
+				int length = 0;
+				while (length < maxLength && candidate[length] == current[length]) length++;
+				if (length > best) {
+					best = length;
+					distance = static_cast<int>(i - j);
+					if (length >= params.nice || length == maxLength) break;
+				}
+			}
+			if (best < MIN_MATCH || (best == MIN_MATCH && distance > FAR_MIN_MATCH)) return 0;
+			return best;
+		};
+
+		std::vector<Token> tokens;
+		tokens.reserve(BLOCK_TOKENS);
+		size_t blockStart = 0;
+		size_t i = 0;
+		while (i < size) {
+			int distance = 0;
+			int length = findMatch(i, distance);
+			insert(i);
+			if (length && params.lazy && length < params.nice) {
+				int nextDistance = 0;
+				int nextLength = findMatch(i + 1, nextDistance);
+				if (nextLength > length) {
+					tokens.push_back(Token{ data[i], 0 });
+					i++;
+					insert(i);
+					length = nextLength;
+					distance = nextDistance;
+				}
+			}
+
+			if (length) {
+				tokens.push_back(Token{ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+				for (size_t k = i + 1; k < i + length; k++) insert(k);
+				i += length;
+			}
+			else {
+				tokens.push_back(Token{ data[i], 0 });
+				i++;
+			}
+
+			if (tokens.size() >= BLOCK_TOKENS) {
+				writeBlock(writer, tokens, data + blockStart, i - blockStart);
+				tokens.clear();
+				blockStart = i;
+			}
+		}
+		if (!tokens.empty()) writeBlock(writer, tokens, data + blockStart, size - blockStart);
+	}
+
+	// sync flush, an empty stored block brings the stream to a byte boundary
+	writer.put(0, 3);
+	writer.align();
+	writer.put(0, 16);
+	writer.put(0xFFFF, 16);
+}
+
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler) {
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	// the sums are reduced every 5552 bytes, before they can overflow
+	for (size_t offset = 0; offset < size; offset += 5552) {
+		size_t end = std::min(size, offset + 5552);
+		for (size_t i = offset; i < end; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= ADLER_MOD;
+		b %= ADLER_MOD;
+	}
+	return (b << 16) | a;
+}
+
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize) {
+	uint32_t remainder = static_cast<uint32_t>(secondSize % ADLER_MOD);
+	uint32_t a = first & 0xFFFF;
+	uint32_t b = (remainder * a) % ADLER_MOD;
+	a += (second & 0xFFFF) + ADLER_MOD - 1;
+	b += (first >> 16) + (second >> 16) + ADLER_MOD - remainder;
+	if (a >= ADLER_MOD) a -= ADLER_MOD;
+	if (a >= ADLER_MOD) a -= ADLER_MOD;
+	if (b >= ADLER_MOD * 2) b -= ADLER_MOD * 2;
+	if (b >= ADLER_MOD) b -= ADLER_MOD;
+	return (b << 16) | a;
+}
\ No newline at end of file
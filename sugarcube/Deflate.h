@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// deflate compression of independent pieces of one stream. A piece never
+// refers back into the data before it and ends byte aligned with a sync
+// flush, so pieces compressed in parallel join by concatenation. The
+// stream still needs a final block after the last piece.
+// level 0 only stores, 1 is the fastest and 9 compresses the most
+void deflatePiece(const uint8_t* data, size_t size, int level, std::vector<uint8_t>& out);
+
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+// checksum of two joined pieces from the checksums of each
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize);
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "GLContext.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#if SUGARCUBE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#if SUGARCUBE_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+#include <iostream>
+
+#if SUGARCUBE_OSMESA
+static void* osMesaProcAddress(const char* name) {
+	return reinterpret_cast<void*>(OSMesaGetProcAddress(name));
+}
+#endif
+
+GLContext::GLContext() :
+	backend(ContextBackend::Auto),
+	created(false),
+	window(nullptr),
+	eglDisplay(nullptr),
+	eglContext(nullptr),
+	osMesaContext(nullptr)
+{}
+
+GLContext::~GLContext() {
+	destroy();
+}
+
+bool GLContext::create(ContextBackend backend, int width, int height, const char* title) {
+	destroy();
+	this->backend = backend;
+
+	switch (backend) {
+	case ContextBackend::Window: created = createGlfw(true, width, height, title); break;
+	case ContextBackend::Hidden: created = createGlfw(false, width, height, title); break;
+	case ContextBackend::EGL: created = createEgl(); break;
+	case ContextBackend::OSMesa: created = createOsMesa(); break;
+	case ContextBackend::Auto:
+		// software rendering without a display comes first, a hidden window
+		// still needs one
+		if (SUGARCUBE_EGL && createEgl()) this->backend = ContextBackend::EGL;
+		else if (SUGARCUBE_OSMESA && createOsMesa()) this->backend = ContextBackend::OSMesa;
+		else if (createGlfw(false, width, height, title)) this->backend = ContextBackend::Hidden;
+		created = this->backend != ContextBackend::Auto;
+		break;
+	}
+	return created;
+}
+
+void GLContext::destroy() {
+	if (window) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		window = nullptr;
+	}
+#if SUGARCUBE_EGL
+	if (eglDisplay) {
+		EGLDisplay display = static_cast<EGLDisplay>(eglDisplay);
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (eglContext) eglDestroyContext(display, static_cast<EGLContext>(eglContext));
+		eglTerminate(display);
+		eglDisplay = nullptr;
+		eglContext = nullptr;
+	}
+#endif
+#if SUGARCUBE_OSMESA
+	if (osMesaContext) {
+		OSMesaDestroyContext(static_cast<OSMesaContext>(osMesaContext));
+		osMesaContext = nullptr;
+		osMesaBuffer.clear();
+	}
+#endif
+	created = false;
+}
+
+ContextBackend GLContext::getBackend() {
+	return backend;
+}
+
+GLFWwindow* GLContext::getWindow() {
+	return window;
+}
+
+bool GLContext::parseBackend(const std::string& name, ContextBackend& backend) {
+	if (name == "auto") backend = ContextBackend::Auto;
+	else if (name == "window") backend = ContextBackend::Window;
+	else if (name == "hidden") backend = ContextBackend::Hidden;
+	else if (name == "egl") backend = ContextBackend::EGL;
+	else if (name == "osmesa") backend = ContextBackend::OSMesa;
+	else return false;
+	return true;
+}
+
+const char* GLContext::backendName(ContextBackend backend) {
+	switch (backend) {
+	case ContextBackend::Window: return "window";
+	case ContextBackend::Hidden: return "hidden";
+	case ContextBackend::EGL: return "egl";
+	case ContextBackend::OSMesa: return "osmesa";
+	default: return "auto";
+	}
+}
+
+bool GLContext::createGlfw(bool visible, int width, int height, const char* title) {
+	if (!glfwInit()) {
+		std::cout << "Failed to initialize GLFW" << std::endl;
+		return false;
+	}
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
+	window = glfwCreateWindow(width, height, title, NULL, NULL);
+	if (window == NULL) {
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	if (visible) glfwSwapInterval(1);
+
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+bool GLContext::createEgl() {
+#if SUGARCUBE_EGL
+	// the surfaceless platform needs neither a display server nor a gpu,
+	// mesa renders with llvmpipe when no hardware driver is found
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+		std::cout << "Failed to initialize EGL" << std::endl;
+		return false;
+	}
+	eglDisplay = display;
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cout << "EGL has no desktop OpenGL" << std::endl;
+		destroy();
+		return false;
+	}
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	// without a matching config the context can still be made current with
+	// no surface, which is all that's needed to draw into framebuffer objects
+	EGLContext context = eglCreateContext(display, configCount > 0 ? config : EGL_NO_CONFIG_KHR,
+		EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT) {
+		std::cout << "Failed to create an EGL OpenGL 3.3 context" << std::endl;
+		destroy();
+		return false;
+	}
+	eglContext = context;
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		std::cout << "EGL can't make a context current without a surface" << std::endl;
+		destroy();
+		return false;
+	}
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		destroy();
+		return false;
+	}
+	return true;
+#else
+	std::cout << "This build has no EGL support, rebuild with SUGARCUBE_EGL" << std::endl;
+	return false;
+#endif
+}
+
+bool GLContext::createOsMesa() {
+#if SUGARCUBE_OSMESA
+	const int attributes[] = {
+		OSMESA_FORMAT, OSMESA_RGBA,
+		OSMESA_DEPTH_BITS, 24,
+		OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+		OSMESA_CONTEXT_MAJOR_VERSION, 3,
+		OSMESA_CONTEXT_MINOR_VERSION, 3,
+		0
+	};
+	OSMesaContext context = OSMesaCreateContextAttribs(attributes, NULL);
+	if (!context) {
+		std::cout << "Failed to create an OSMesa OpenGL 3.3 context" << std::endl;
+		return false;
+	}
+	osMesaContext = context;
+
+	osMesaBuffer.assign(4, 0);
+	if (!OSMesaMakeCurrent(context, osMesaBuffer.data(), GL_UNSIGNED_BYTE, 1, 1)) {
+		std::cout << "Failed to make the OSMesa context current" << std::endl;
+		destroy();
+		return false;
+	}
+	if (!gladLoadGLLoader(osMesaProcAddress)) {
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		destroy();
+		return false;
+	}
+	return true;
+#else
+	std::cout << "This build has no OSMesa support, rebuild with SUGARCUBE_OSMESA" << std::endl;
+	return false;
+#endif
+}
\ No newline at end of file
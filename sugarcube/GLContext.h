@@ -0,0 +1,69 @@
+#pragma once
+// build with SUGARCUBE_EGL or SUGARCUBE_OSMESA defined as 1 to add the
+// context backends that need no window system. They link against libEGL
+// or libOSMesa, which the windows build doesn't ship, so both are off.
+// On linux, with glfw, nativefiledialog (built against gtk 3) and mesa's
+// development files installed, from this directory:
+//   g++ -std=c++17 -O2 -DSUGARCUBE_EGL=1 -Iinclude *.cpp include/imgui/*.cpp
+//     glad.c -o sugarcube -lglfw -lnfd $(pkg-config --libs gtk+-3.0) -lEGL -lpthread -ldl
+// and -DSUGARCUBE_OSMESA=1 with -lOSMesa for OSMesa. In visual studio add
+// the define under C/C++ > Preprocessor and the library under Linker > Input
+#ifndef SUGARCUBE_EGL
+#define SUGARCUBE_EGL 0
+#endif
+#ifndef SUGARCUBE_OSMESA
+#define SUGARCUBE_OSMESA 0
+#endif
+
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+
+enum class ContextBackend {
+	Auto,
+	Window,
+	Hidden,
+	EGL,
+	OSMesa
+};
+
+// owns the OpenGL 3.3 core context everything renders with and loads the
+// GL functions for it. The editor draws into a window, exports can use a
+// hidden window or an EGL surfaceless or OSMesa context on machines with
+// no display or GPU. Those have no default framebuffer, so all drawing
+// goes into framebuffer objects the way the image exporter already works
+class GLContext {
+
+public:
+	GLContext();
+	~GLContext();
+
+	// Auto tries the backends without a window system that were built in,
+	// then falls back to a hidden window. The size only matters for windows
+	bool create(ContextBackend backend, int width = 1, int height = 1, const char* title = "sugarcube");
+	void destroy();
+
+	ContextBackend getBackend();
+	// null unless the context belongs to a window
+	GLFWwindow* getWindow();
+
+	static bool parseBackend(const std::string& name, ContextBackend& backend);
+	static const char* backendName(ContextBackend backend);
+
+private:
+	bool createGlfw(bool visible, int width, int height, const char* title);
+	bool createEgl();
+	bool createOsMesa();
+
+	ContextBackend backend;
+	bool created;
+	GLFWwindow* window;
+	// kept untyped so the EGL and OSMesa headers stay out of this one
+	void* eglDisplay;
+	void* eglContext;
+	void* osMesaContext;
+	// OSMesa needs a color buffer to make the context current, nothing is
+	// drawn into it
+	std::vector<unsigned char> osMesaBuffer;
+};
\ No newline at end of file
@@ -0,0 +1,309 @@
+#include "GltfExporter.h"
+#include "Automata3D.h"
+#include "GreedyMesher.h"
+#include "Trace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::string formatFloats(const float* values, int count) {
+	std::ostringstream out;
+	out.precision(9);
+	out << "[";
+	for (int i = 0; i < count; i++) out << (i ? "," : "") << values[i];
+	out << "]";
+	return out.str();
+}
+
+static std::string joinObjects(const char* name, const std::vector<std::string>& objects) {
+	if (objects.empty()) return "";
+	std::string json = ",\"" + std::string(name) + "\":[";
+	for (size_t i = 0; i < objects.size(); i++) {
+		if (i) json += ",";
+		json += objects[i];
+	}
+	return json + "]";
+}
+
+GltfExporter::GltfExporter() :
+	binaryLength(0)
+{}
+
+bool GltfExporter::exportInstanced(const char* path, const std::vector<vec3>& translations) {
+	TRACE_SCOPE("exportGltf");
+	if (translations.empty()) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+
+	clear();
+	int mesh = addCubeMesh();
+	int view = addBufferView(&translations[0], translations.size() * sizeof(vec3));
+	int accessor = addAccessor(view, 0, FLOAT, translations.size(), "VEC3");
+	addNode("\"mesh\":" + std::to_string(mesh) +
+		",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{\"TRANSLATION\":" +
+		std::to_string(accessor) + "}}}");
+	return write(path, { "EXT_mesh_gpu_instancing" });
+}
+
+bool GltfExporter::exportMerged(const char* path, GridView grid) {
+	TRACE_SCOPE("exportGltf");
+	if (!grid.isValid()) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+
+	clear();
+	int mesh = addMergedMesh(grid);
+	if (mesh < 0) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+	addNode("\"mesh\":" + std::to_string(mesh));
+	return write(path, {});
+}
+
+bool GltfExporter::exportAnimated(const char* path, const std::vector<VisibilityTrack>& tracks,
+	int frames, float secondsPerFrame)
+{
+	TRACE_SCOPE("exportGltf");
+	if (tracks.empty()) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+
+	clear();
+	int mesh = addCubeMesh();
+	std::string samplers;
+	std::string channels;
+	int samplerCount = 0;
+	float duration = frames * secondsPerFrame;
+	for (const VisibilityTrack& track : tracks) {
+		if (track.toggles.empty() || track.translations.empty()) continue;
+
+		// keyframes switch the scale between zero and one, a final key at the
+		// end keeps every track as long as the whole animation
+		std::vector<float> times;
+		std::vector<vec3> scales;
+		if (track.toggles[0] != 0) {
+			times.push_back(0.0f);
+			scales.push_back(vec3(0.0f));
+		}
+		for (size_t i = 0; i < track.toggles.size(); i++) {
+			times.push_back(track.toggles[i] * secondsPerFrame);
+			scales.push_back(vec3(i % 2 == 0 ? 1.0f : 0.0f));
+		}
+		if (times.back() < duration) {
+			times.push_back(duration);
+			scales.push_back(scales.back());
+		}
+
+		size_t keys = times.size();
+		float first = times.front();
+		float last = times.back();
+		int input = addAccessor(addOwnedBufferView(std::vector<char>(
+			reinterpret_cast<const char*>(times.data()),
+			reinterpret_cast<const char*>(times.data() + keys))),
+			0, FLOAT, keys, "SCALAR", &first, &last);
+		int output = addAccessor(addOwnedBufferView(std::vector<char>(
+			reinterpret_cast<const char*>(scales.data()),
+			reinterpret_cast<const char*>(scales.data() + keys))),
+			0, FLOAT, keys, "VEC3");
+
+		// the translations are owned by the caller, like the renderer's blocks
+		int translations = addAccessor(addBufferView(&track.translations[0],
+			track.translations.size() * sizeof(vec3)),
+			0, FLOAT, track.translations.size(), "VEC3");
+		int node = addNode("\"mesh\":" + std::to_string(mesh) +
+			",\"scale\":" + formatFloats(&scales[0].x, 3) +
+			",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{\"TRANSLATION\":" +
+			std::to_string(translations) + "}}}");
+
+		int sampler = samplerCount++;
+		samplers += (samplers.empty() ? "" : ",") + std::string("{\"input\":") + std::to_string(input) +
+			",\"output\":" + std::to_string(output) + ",\"interpolation\":\"STEP\"}";
+		channels += (channels.empty() ? "" : ",") + std::string("{\"sampler\":") + std::to_string(sampler) +
+			",\"target\":{\"node\":" + std::to_string(node) + ",\"path\":\"scale\"}}";
+	}
+
+	if (samplerCount == 0) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+	animations.push_back("{\"name\":\"generations\",\"samplers\":[" + samplers +
+		"],\"channels\":[" + channels + "]}");
+	return write(path, { "EXT_mesh_gpu_instancing" });
+}
+
+void GltfExporter::clear() {
+	bufferViews.clear();
+	accessors.clear();
+	meshes.clear();
+	nodes.clear();
+	animations.clear();
+	segments.clear();
+	ownedData.clear();
+	binaryLength = 0;
+}
+
+int GltfExporter::addBufferView(const void* data, size_t bytes, int target, size_t stride) {
+	std::string view = "{\"buffer\":0,\"byteOffset\":" + std::to_string(binaryLength) +
+		",\"byteLength\":" + std::to_string(bytes);
+	if (target) view += ",\"target\":" + std::to_string(target);
+	if (stride) view += ",\"byteStride\":" + std::to_string(stride);
+	bufferViews.push_back(view + "}");
+
+	// every view starts on a 4 byte boundary, which covers all the
+	// component types used here
+	segments.push_back({ static_cast<const char*>(data), bytes });
+	binaryLength += bytes;
+	size_t padding = (4 - binaryLength % 4) % 4;
+	if (padding) {
+		static const char zeros[4] = {};
+		segments.push_back({ zeros, padding });
+		binaryLength += padding;
+	}
+	return static_cast<int>(bufferViews.size()) - 1;
+}
+
+int GltfExporter::addOwnedBufferView(std::vector<char>&& data, int target) {
+	ownedData.push_back(std::move(data));
+	const std::vector<char>& owned = ownedData.back();
+	return addBufferView(owned.data(), owned.size(), target);
+}
+
+int GltfExporter::addAccessor(int bufferView, size_t byteOffset, int componentType,
+	size_t count, const char* type, const float* min, const float* max)
+{
+	std::string accessor = "{\"bufferView\":" + std::to_string(bufferView) +
+		",\"byteOffset\":" + std::to_string(byteOffset) +
+		",\"componentType\":" + std::to_string(componentType) +
+		",\"count\":" + std::to_string(count) +
+		",\"type\":\"" + type + "\"";
+	if (min && max) {
+		int components = std::string(type) == "SCALAR" ? 1 : 3;
+		accessor += ",\"min\":" + formatFloats(min, components);
+		accessor += ",\"max\":" + formatFloats(max, components);
+	}
+	accessors.push_back(accessor + "}");
+	return static_cast<int>(accessors.size()) - 1;
+}
+
+int GltfExporter::addCubeMesh() {
+	// the vertex table interleaves position and normal, so both accessors
+	// read the same view with a stride
+	const Automata3D::Vertex* vertices = Automata3D::cubeVertices;
+	size_t stride = sizeof(Automata3D::Vertex);
+	int vertexView = addBufferView(vertices, 24 * stride, ARRAY_BUFFER, stride);
+	int indexView = addBufferView(Automata3D::cubeIndices, sizeof(Automata3D::cubeIndices),
+		ELEMENT_ARRAY_BUFFER);
+
+	const float min[3] = { -0.5f, -0.5f, -0.5f };
+	const float max[3] = { 0.5f, 0.5f, 0.5f };
+	int positions = addAccessor(vertexView, 0, FLOAT, 24, "VEC3", min, max);
+	int normals = addAccessor(vertexView, offsetof(Automata3D::Vertex, normal), FLOAT, 24, "VEC3");
+	int indices = addAccessor(indexView, 0, UNSIGNED_INT, 36, "SCALAR");
+	return addMesh(positions, normals, indices);
+}
+
+int GltfExporter::addMergedMesh(GridView grid) {
+	std::vector<Quad> quads;
+	GreedyMesher(grid).meshAll(quads);
+	if (quads.empty()) return -1;
+
+	// four vertices per quad since the normal changes between faces
+	std::vector<char> positionData(quads.size() * 4 * sizeof(vec3));
+	std::vector<char> normalData(quads.size() * 4 * sizeof(vec3));
+	std::vector<char> indexData(quads.size() * 6 * sizeof(uint32_t));
+	vec3* positions = reinterpret_cast<vec3*>(positionData.data());
+	vec3* normals = reinterpret_cast<vec3*>(normalData.data());
+	uint32_t* indices = reinterpret_cast<uint32_t*>(indexData.data());
+
+	// the accessor bounds must match the vertices exactly, not the grid
+	vec3 center = vec3(grid.size) * 0.5f;
+	vec3 min = vec3(quads[0].corners[0]) - center;
+	vec3 max = min;
+	for (size_t i = 0; i < quads.size(); i++) {
+		for (int c = 0; c < 4; c++) {
+			vec3 position = vec3(quads[i].corners[c]) - center;
+			positions[4 * i + c] = position;
+			normals[4 * i + c] = vec3(faceNormals[quads[i].normal]);
+			min = glm::min(min, position);
+			max = glm::max(max, position);
+		}
+		uint32_t first = static_cast<uint32_t>(4 * i);
+		uint32_t quadIndices[6] = { first, first + 1, first + 2, first + 2, first + 3, first };
+		for (int c = 0; c < 6; c++) indices[6 * i + c] = quadIndices[c];
+	}
+
+	size_t vertexCount = quads.size() * 4;
+	int positionAccessor = addAccessor(addOwnedBufferView(std::move(positionData), ARRAY_BUFFER),
+		0, FLOAT, vertexCount, "VEC3", &min.x, &max.x);
+	int normalAccessor = addAccessor(addOwnedBufferView(std::move(normalData), ARRAY_BUFFER),
+		0, FLOAT, vertexCount, "VEC3");
+	int indexAccessor = addAccessor(addOwnedBufferView(std::move(indexData), ELEMENT_ARRAY_BUFFER),
+		0, UNSIGNED_INT, quads.size() * 6, "SCALAR");
+	return addMesh(positionAccessor, normalAccessor, indexAccessor);
+}
+
+int GltfExporter::addMesh(int positions, int normals, int indices) {
+	meshes.push_back("{\"primitives\":[{\"attributes\":{\"POSITION\":" + std::to_string(positions) +
+		",\"NORMAL\":" + std::to_string(normals) + "},\"indices\":" + std::to_string(indices) + "}]}");
+	return static_cast<int>(meshes.size()) - 1;
+}
+
+int GltfExporter::addNode(const std::string& properties) {
+	nodes.push_back("{" + properties + "}");
+	return static_cast<int>(nodes.size()) - 1;
+}
+
+bool GltfExporter::write(const char* path, const std::vector<std::string>& extensions) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+
+	std::string sceneNodes;
+	for (size_t i = 0; i < nodes.size(); i++)
+		sceneNodes += (i ? "," : "") + std::to_string(i);
+
+	std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"sugarcube\"}";
+	if (!extensions.empty()) {
+		std::string names;
+		for (size_t i = 0; i < extensions.size(); i++)
+			names += (i ? ",\"" : "\"") + extensions[i] + "\"";
+		json += ",\"extensionsUsed\":[" + names + "],\"extensionsRequired\":[" + names + "]";
+	}
+	json += ",\"scene\":0,\"scenes\":[{\"nodes\":[" + sceneNodes + "]}]";
+	json += joinObjects("nodes", nodes);
+	json += joinObjects("meshes", meshes);
+	json += joinObjects("animations", animations);
+	json += joinObjects("accessors", accessors);
+	json += joinObjects("bufferViews", bufferViews);
+	json += ",\"buffers\":[{\"byteLength\":" + std::to_string(binaryLength) + "}]}";
+	// the json chunk is padded with spaces, the binary chunk is already aligned
+	json.append((4 - json.size() % 4) % 4, ' ');
+
+	// header, then the json and binary chunks, each with length and type
+	uint32_t header[3] = { 0x46546C67, 2,
+		static_cast<uint32_t>(12 + 8 + json.size() + 8 + binaryLength) };
+	uint32_t jsonChunk[2] = { static_cast<uint32_t>(json.size()), 0x4E4F534A };
+	uint32_t binaryChunk[2] = { static_cast<uint32_t>(binaryLength), 0x004E4942 };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+	file.write(json.data(), json.size());
+	file.write(reinterpret_cast<const char*>(binaryChunk), sizeof(binaryChunk));
+	for (const Segment& segment : segments)
+		file.write(segment.data, segment.size);
+
+	file.close();
+	if (file.fail()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
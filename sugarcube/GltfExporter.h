@@ -0,0 +1,72 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "GridView.h"
+
+using vec3 = glm::vec3;
+
+// writes self contained binary gltf (.glb) files. Instanced scenes hold one
+// cube mesh and a translation per block through EXT_mesh_gpu_instancing,
+// merged scenes hold a greedy meshed copy of the grid for viewers without
+// the extension
+class GltfExporter {
+
+public:
+	GltfExporter();
+
+	// translations are the renderer's block positions, they are written
+	// to the file as they are without being copied
+	bool exportInstanced(const char* path, const std::vector<vec3>& translations);
+	bool exportMerged(const char* path, GridView grid);
+
+	// blocks that share the same visibility over an animation, toggles are
+	// the frames where they appear and disappear, starting hidden
+	struct VisibilityTrack {
+		std::vector<int> toggles;
+		std::vector<vec3> translations;
+	};
+
+	// one instanced node per track, animated with step keyframes on scale
+	bool exportAnimated(const char* path, const std::vector<VisibilityTrack>& tracks,
+		int frames, float secondsPerFrame);
+
+private:
+	// component types and buffer view targets from the gltf spec
+	static const int FLOAT = 5126;
+	static const int UNSIGNED_INT = 5125;
+	static const int ARRAY_BUFFER = 34962;
+	static const int ELEMENT_ARRAY_BUFFER = 34963;
+
+	void clear();
+	// views reference the data directly, it has to outlive write()
+	int addBufferView(const void* data, size_t bytes, int target = 0, size_t stride = 0);
+	// views of data owned by the exporter, for anything generated on the fly
+	int addOwnedBufferView(std::vector<char>&& data, int target = 0);
+	int addAccessor(int bufferView, size_t byteOffset, int componentType, size_t count,
+		const char* type, const float* min = nullptr, const float* max = nullptr);
+	int addCubeMesh();
+	int addMergedMesh(GridView grid);
+	int addMesh(int positions, int normals, int indices);
+	// properties are the members of the node object, without braces
+	int addNode(const std::string& properties);
+	bool write(const char* path, const std::vector<std::string>& extensions);
+
+	std::vector<std::string> bufferViews;
+	std::vector<std::string> accessors;
+	std::vector<std::string> meshes;
+	std::vector<std::string> nodes;
+	std::vector<std::string> animations;
+
+	struct Segment {
+		const char* data;
+		size_t size;
+	};
+
+	std::vector<Segment> segments;
+	std::deque<std::vector<char>> ownedData;
+	size_t binaryLength;
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "GreedyMesher.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+GreedyMesher::GreedyMesher(GridView grid) :
+	grid(grid)
+{}
+
+int GreedyMesher::sliceCount() {
+	// each of the six directions has one slice per layer along its axis
+	return 2 * (grid.size.x + grid.size.y + grid.size.z);
+}
+
+void GreedyMesher::meshSlices(int first, int count, std::vector<Quad>& quads) {
+	TRACE_SCOPE("greedyMesh");
+	std::vector<std::vector<Quad>> results(count);
+	ThreadPool::shared().parallelFor(0, count, [&](int i) {
+		meshSlice(first + i, results[i]);
+	});
+
+	for (const std::vector<Quad>& result : results)
+		quads.insert(quads.end(), result.begin(), result.end());
+}
+
+void GreedyMesher::meshAll(std::vector<Quad>& quads) {
+	meshSlices(0, sliceCount(), quads);
+}
+
+void GreedyMesher::meshSlice(int slice, std::vector<Quad>& quads) {
+	// find which direction and layer this slice index refers to
+	int normal = 0;
+	while (slice >= grid.size[normal / 2]) {
+		slice -= grid.size[normal / 2];
+		normal++;
+	}
+	int axis = normal / 2;
+	int uAxis = (axis + 1) % 3;
+	int vAxis = (axis + 2) % 3;
+	int width = grid.size[uAxis];
+	int height = grid.size[vAxis];
+
+	// mask of the faces in this slice that are visible
+	std::vector<char> mask(width * height, 0);
+	for (int v = 0; v < height; v++) {
+		for (int u = 0; u < width; u++) {
+			ivec3 cell(0);
+			cell[axis] = slice;
+			cell[uAxis] = u;
+			cell[vAxis] = v;
+			ivec3 neighbor = cell + faceNormals[normal];
+			mask[v * width + u] = !grid.isEmpty(cell.x, cell.y, cell.z) &&
+				grid.isEmpty(neighbor.x, neighbor.y, neighbor.z);
+		}
+	}
+
+	// grow a rectangle from each remaining face, first along u then along
+	// v for as long as the whole row is still visible, then clear it
+	for (int v = 0; v < height; v++) {
+		for (int u = 0; u < width; u++) {
+			if (!mask[v * width + u]) continue;
+
+			int w = 1;
+			while (u + w < width && mask[v * width + u + w]) w++;
+
+			int h = 1;
+			for (; v + h < height; h++) {
+				bool rowVisible = true;
+				for (int i = 0; i < w && rowVisible; i++)
+					rowVisible = mask[(v + h) * width + u + i] != 0;
+				if (!rowVisible) break;
+			}
+
+			for (int j = 0; j < h; j++)
+				for (int i = 0; i < w; i++)
+					mask[(v + j) * width + u + i] = 0;
+
+			ivec3 cell(0);
+			cell[axis] = slice;
+			cell[uAxis] = u;
+			cell[vAxis] = v;
+			quads.push_back(makeQuad(cell, normal, w, h));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+
+#include "GridView.h"
+#include "Quad.h"
+
+// merges coplanar, same facing visible faces into maximal rectangles, one
+// slice of the grid at a time; slices are independent so they are meshed
+// in parallel
+class GreedyMesher {
+
+public:
+	GreedyMesher(GridView grid);
+
+	// number of (direction, slice) pairs, the unit of parallel work
+	int sliceCount();
+
+	// meshes slices [first, first + count) across the shared thread pool,
+	// quads are appended in slice order
+	void meshSlices(int first, int count, std::vector<Quad>& quads);
+	void meshAll(std::vector<Quad>& quads);
+
+	// meshes a single slice on the calling thread
+	void meshSlice(int slice, std::vector<Quad>& quads);
+
+private:
+	GridView grid;
+};
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// non-owning, read only view of a simulation grid, it must not outlive the
+// storage it was created from
+class GridView {
+
+public:
+	GridView() : cells(nullptr), size(0) {}
+	GridView(const std::vector<bool>& cells, glm::ivec3 size) :
+		cells(&cells), size(size) {}
+
+	int coordsToIndex(int x, int y, int z) const {
+		return z * size.x * size.y + y * size.x + x;
+	}
+
+	bool isEmpty(int x, int y, int z) const {
+		if (x < 0 || x >= size.x ||
+			y < 0 || y >= size.y ||
+			z < 0 || z >= size.z)
+			return true;
+		return !(*cells)[coordsToIndex(x, y, z)];
+	}
+
+	bool isValid() const { return cells != nullptr && !cells->empty(); }
+
+	const std::vector<bool>* cells;
+	glm::ivec3 size;
+};
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "History.h"
+#include "CellPacking.h"
+#include "Trace.h"
+
+History::History() :
+	keyframeInterval(32),
+	memoryCap(256 << 20),
+	first(0),
+	sinceKeyframe(0),
+	size(0),
+	bytes(0)
+{}
+
+void History::record(const Automata3D& simulation) {
+	TRACE_SCOPE("recordHistory");
+	int generation = simulation.getGeneration();
+	bool continues = !frames.empty() && simulation.getSize() == size &&
+		generation >= first && generation <= lastGeneration() + 1;
+	if (continues && generation <= lastGeneration()) return;
+	if (!continues) clear();
+
+	Frame frame;
+	frame.keyframe = frames.empty() || sinceKeyframe + 1 >= keyframeInterval;
+	if (frame.keyframe) {
+		GridView grid = simulation.getGrid();
+		std::vector<uint8_t> packed((grid.cells->size() + 7) / 8);
+		packCells(*grid.cells, 0, grid.cells->size(), packed.data());
+		encodeZeroRuns(packed.data(), packed.size(), frame.data);
+		sinceKeyframe = 0;
+	}
+	else {
+		encodeChangeList(simulation.getChanges(), frame.data);
+		sinceKeyframe++;
+	}
+	frame.data.shrink_to_fit();
+
+	if (frames.empty()) {
+		first = generation;
+		size = simulation.getSize();
+	}
+	bytes += frame.data.size();
+	frames.push_back(std::move(frame));
+	evict();
+}
+
+void History::clear() {
+	frames.clear();
+	first = 0;
+	sinceKeyframe = 0;
+	bytes = 0;
+}
+
+void History::evict() {
+	// drop the oldest keyframe and its change lists together, the newest
+	// keyframe is always kept even if it alone is over the cap
+	while (bytes > memoryCap) {
+		size_t next = 1;
+		while (next < frames.size() && !frames[next].keyframe) next++;
+		if (next == frames.size()) return;
+		for (size_t i = 0; i < next; i++) {
+			bytes -= frames.front().data.size();
+			frames.pop_front();
+		}
+		first += static_cast<int>(next);
+	}
+}
+
+bool History::seek(int generation, Automata3D& simulation) const {
+	TRACE_SCOPE("seekHistory");
+	if (frames.empty() || generation < first || generation > lastGeneration()) return false;
+
+	size_t target = generation - first;
+	size_t keyframe = target;
+	while (!frames[keyframe].keyframe) keyframe--;
+
+	size_t cellCount = static_cast<size_t>(size.x) * size.y * size.z;
+	std::vector<uint8_t> packed((cellCount + 7) / 8);
+	const std::vector<uint8_t>& data = frames[keyframe].data;
+	if (!decodeZeroRuns(data.data(), data.size(), packed.data(), packed.size())) return false;
+	std::vector<bool> cells(cellCount);
+	unpackCells(packed.data(), 0, cellCount, cells);
+
+	for (size_t i = keyframe + 1; i <= target; i++) {
+		if (!applyChangeList(frames[i].data.data(), frames[i].data.size(), cells)) return false;
+	}
+
+	simulation.setState(size, generation, std::move(cells));
+	return true;
+}
+
+bool History::isEmpty() const {
+	return frames.empty();
+}
+
+int History::firstGeneration() const {
+	return first;
+}
+
+int History::lastGeneration() const {
+	return first + static_cast<int>(frames.size()) - 1;
+}
+
+size_t History::memoryUsed() const {
+	return bytes;
+}
\ No newline at end of file
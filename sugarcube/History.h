@@ -0,0 +1,53 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Automata3D.h"
+
+using ivec3 = glm::ivec3;
+
+// in memory record of past generations for scrubbing back through a run.
+// Every keyframeInterval generations the whole grid is stored, packed and
+// zero run encoded, the generations between hold the step's change list.
+// The oldest generations are dropped to stay under memoryCap
+class History {
+
+public:
+	History();
+
+	// records the simulation's current generation. A generation that doesn't
+	// follow the recorded ones starts over from a keyframe, generations that
+	// are already recorded are skipped since stepping is deterministic. The
+	// history has to be cleared when the grid or rule changes otherwise
+	void record(const Automata3D& simulation);
+	void clear();
+	// restores a recorded generation in at most keyframeInterval change
+	// lists, the recorded generations after it are kept
+	bool seek(int generation, Automata3D& simulation) const;
+
+	bool isEmpty() const;
+	int firstGeneration() const;
+	int lastGeneration() const;
+	size_t memoryUsed() const;
+
+	int keyframeInterval;
+	size_t memoryCap;
+
+private:
+	struct Frame {
+		bool keyframe;
+		std::vector<uint8_t> data;
+	};
+
+	void evict();
+
+	// frames[i] holds generation first + i
+	std::deque<Frame> frames;
+	int first;
+	int sinceKeyframe;
+	ivec3 size;
+	size_t bytes;
+};
\ No newline at end of file
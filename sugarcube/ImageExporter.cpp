@@ -1,23 +1,125 @@
 #include "ImageExporter.h"
+#include "ImageStream.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
 #include <vector>
 
+#ifdef _MSC_VER
 #define STBI_MSC_SECURE_CRT
+#endif
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+// runs on the encoder threads, pixels stay mapped until it returns
+static bool writeImage(const char* path, ImageFormats format, int compression,
+	GLsizei w, GLsizei h, const unsigned char* pixels)
+{
+	TRACE_SCOPE("encode");
+	// png goes through the parallel encoder, the uncompressed formats are
+	// written from the mapped pixels as they are. Both report their own errors
+	if (format == ImageFormats::PNG || format == ImageFormats::PPM ||
+		format == ImageFormats::PAM || format == ImageFormats::RAW)
+	{
+		ImageStream stream;
+		if (!stream.open(path, format, w, h, compression)) return false;
+		stream.writeRows(pixels, h);
+		return stream.close();
+	}
+
+	int written = 0;
+	switch (format) {
+	case ImageFormats::BMP:
+		written = stbi_write_bmp(path, w, h, 3, pixels);
+		break;
+	case ImageFormats::TGA:
+		written = stbi_write_tga(path, w, h, 3, pixels);
+		break;
+	case ImageFormats::JPEG:
+		written = stbi_write_jpg(path, w, h, 3, pixels, 100);
+		break;
+	default:
+		break;
+	}
+	if (!written) std::cout << "Error: could not write image to path\n" << path << std::endl;
+	return written != 0;
+}
+
+// averages each factor x factor block of the source into one pixel, rows
+// are spread over the pool. The inner loops run over whole rows of bytes
+// so the compiler can vectorize them
+static void downsample(const unsigned char* source, GLsizei width, GLsizei rows,
+	int factor, unsigned char* out)
+{
+	TRACE_SCOPE("downsample");
+	size_t sourceRow = static_cast<size_t>(width) * factor * 3;
+	int area = factor * factor;
+	ThreadPool::shared().parallelFor(0, rows, [&](int y) {
+		std::vector<uint16_t> columns(sourceRow, 0);
+		for (int k = 0; k < factor; k++) {
+			const unsigned char* line = source + (static_cast<size_t>(y) * factor + k) * sourceRow;
+			for (size_t i = 0; i < sourceRow; i++) columns[i] += line[i];
+		}
+		unsigned char* pixel = out + static_cast<size_t>(y) * width * 3;
+		for (GLsizei x = 0; x < width; x++) {
+			for (int c = 0; c < 3; c++) {
+				int sum = 0;
+				for (int k = 0; k < factor; k++) sum += columns[(static_cast<size_t>(x) * factor + k) * 3 + c];
+				pixel[x * 3 + c] = static_cast<unsigned char>((sum + area / 2) / area);
+			}
+		}
+	});
+}
+
+// multisampled color and depth renderbuffers, resolved with a blit into a
+// framebuffer that can be read back
+static void buildMultisampled(GLuint fbo, GLuint color, GLuint depth,
+	GLsizei width, GLsizei height, GLsizei samples)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGB8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_RENDERBUFFER, color);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+		GL_RENDERBUFFER, depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 ImageExporter::ImageExporter(GLsizei width, GLsizei height) :
-	w(width), h(height)
+	pngCompression(6),
+	samples(1),
+	supersample(1),
+	w(width), h(height),
+	savedDrawFramebuffer(0), savedReadFramebuffer(0),
+	maxSize(0),
+	maxSamples(1),
+	builtSamples(1),
+	captureFactor(1),
+	tileSize(0),
+	tileSamples(1),
+	started(0), finished(0), failed(0)
 {}
 
 void ImageExporter::initialize() {
 	glGenFramebuffers(1, &fbo);
 	glGenTextures(1, &colorBuffer);
 	glGenTextures(1, &depthBuffer);
+	glGenFramebuffers(1, &msFbo);
+	glGenRenderbuffers(1, &msColorBuffer);
+	glGenRenderbuffers(1, &msDepthBuffer);
 
-	GLint viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
-	oldWidth = viewport[2];
-	oldHeight = viewport[3];
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	GLint textureSize, renderbufferSize, viewportSize[2];
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &textureSize);
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &renderbufferSize);
+	glGetIntegerv(GL_MAX_VIEWPORT_DIMS, viewportSize);
+	maxSize = std::min({ textureSize, renderbufferSize, viewportSize[0], viewportSize[1] });
 
 	buildFramebuffer();
 }
@@ -26,7 +128,7 @@ void ImageExporter::buildFramebuffer() {
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
 	glBindTexture(GL_TEXTURE_2D, colorBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, 
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGB, 
 		GL_UNSIGNED_BYTE, NULL);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
 		GL_TEXTURE_2D, colorBuffer, 0);
@@ -39,20 +141,26 @@ void ImageExporter::buildFramebuffer() {
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	builtSamples = sampleCount();
+	if (builtSamples > 1) buildMultisampled(msFbo, msColorBuffer, msDepthBuffer, w, h, builtSamples);
 }
 
 void ImageExporter::beginCapture(GLsizei width, GLsizei height) {
-	// resize framebuffer to desired output size
-	if (width != w || height != h) resize(width, height);
+	// save the viewport and framebuffers to restore afterwards, before
+	// resizing rebinds the framebuffer
+	glGetIntegerv(GL_VIEWPORT, savedViewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedDrawFramebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &savedReadFramebuffer);
 
-	// save previous glviewport size to restore afterwards
-	GLint viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
-	oldWidth = viewport[2];
-	oldHeight = viewport[3];
+	// resize framebuffer to desired output size, times the supersampling
+	captureFactor = std::max(supersample, 1);
+	width *= captureFactor;
+	height *= captureFactor;
+	if (width != w || height != h || sampleCount() != builtSamples) resize(width, height);
 
 	// prepare framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, builtSamples > 1 ? msFbo : fbo);
 	glViewport(0, 0, w, h);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -60,27 +168,240 @@ void ImageExporter::beginCapture(GLsizei width, GLsizei height) {
 }
 
 void ImageExporter::saveImage(const char* path, ImageFormats format) {
-	std::vector<unsigned char> buf(w * h * 3);
+	Capture capture;
+	capture.width = w;
+	capture.height = h;
+	capture.factor = captureFactor;
+	capture.path = path;
+	capture.format = format;
+	capture.compression = pngCompression;
+	capture.pixels = nullptr;
+	capture.written = false;
+	{
+		TRACE_SCOPE("readback");
+		if (builtSamples > 1) {
+			// resolve the samples into the texture that is read back
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, msFbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+			glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		}
+
+		GLint packAlignment;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+		glGenBuffers(1, &capture.pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(w) * h * 3, NULL, GL_STREAM_READ);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		capture.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+	}
+
+	if (captures.empty()) started = finished = failed = 0;
+	captures.push_back(std::move(capture));
+	started++;
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, savedDrawFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, savedReadFramebuffer);
+	glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+}
+
+bool ImageExporter::poll() {
+	for (auto it = captures.begin(); it != captures.end();) {
+		Capture& capture = *it;
+
+		// map the buffer once the gpu has filled it and hand it to an encoder
+		if (!capture.pixels) {
+			if (glClientWaitSync(capture.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				++it;
+				continue;
+			}
+			glDeleteSync(capture.fence);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+			capture.pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+				static_cast<GLsizeiptr>(capture.width) * capture.height * 3, GL_MAP_READ_BIT);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			const unsigned char* pixels = static_cast<const unsigned char*>(capture.pixels);
+			const char* path = capture.path.c_str();
+			ImageFormats format = capture.format;
+			int compression = capture.compression;
+			GLsizei width = capture.width;
+			GLsizei height = capture.height;
+			int factor = capture.factor;
+			bool* written = &capture.written;
+			capture.encoded = ThreadPool::shared().enqueue([=] {
+				if (!pixels) return;
+				if (factor == 1) {
+					*written = writeImage(path, format, compression, width, height, pixels);
+					return;
+				}
+				// supersampled captures are averaged down to the output size first
+				std::vector<unsigned char> reduced(static_cast<size_t>(width / factor) * (height / factor) * 3);
+				downsample(pixels, width / factor, height / factor, factor, reduced.data());
+				*written = writeImage(path, format, compression, width / factor, height / factor, reduced.data());
+			});
+			if (!pixels) std::cout << "Error: could not map the image readback" << std::endl;
+			++it;
+			continue;
+		}
+
+		// release the buffer once the encoder is done with it
+		if (capture.encoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++it;
+			continue;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteBuffers(1, &capture.pbo);
+		if (!capture.written) failed++;
+		it = captures.erase(it);
+		finished++;
+	}
+	return !captures.empty();
+}
+
+bool ImageExporter::finish() {
+	while (poll()) {
+		for (Capture& capture : captures) {
+			if (!capture.pixels) glClientWaitSync(capture.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			else capture.encoded.wait();
+		}
+	}
+	return failed == 0;
+}
+
+int ImageExporter::pendingCount() const {
+	return static_cast<int>(captures.size());
+}
+
+float ImageExporter::progress() const {
+	if (started == 0) return 1.0f;
+	return static_cast<float>(finished) / static_cast<float>(started);
+}
+
+bool ImageExporter::saveTiled(const char* path, ImageFormats format, GLsizei width, GLsizei height,
+	const std::function<void(float x, float y, float w, float h)>& drawTile)
+{
+	TRACE_SCOPE("saveTiled");
+	ImageStream stream;
+	if (!stream.open(path, format, width, height, pngCompression)) return false;
+
+	if (tileSize == 0) {
+		tileSize = std::min<GLsizei>(1024, maxSize);
+		glGenFramebuffers(1, &tileFbo);
+		glGenTextures(1, &tileColorBuffer);
+		glGenTextures(1, &tileDepthBuffer);
+		glGenFramebuffers(1, &tileMsFbo);
+		glGenRenderbuffers(1, &tileMsColorBuffer);
+		glGenRenderbuffers(1, &tileMsDepthBuffer);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, tileFbo);
+		glBindTexture(GL_TEXTURE_2D, tileColorBuffer);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, tileSize, tileSize, 0, GL_RGB,
+			GL_UNSIGNED_BYTE, NULL);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, tileColorBuffer, 0);
+		glBindTexture(GL_TEXTURE_2D, tileDepthBuffer);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, tileSize, tileSize, 0,
+			GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+			GL_TEXTURE_2D, tileDepthBuffer, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLsizei samples = sampleCount();
+	if (samples > 1 && samples != tileSamples) {
+		buildMultisampled(tileMsFbo, tileMsColorBuffer, tileMsDepthBuffer, tileSize, tileSize, samples);
+		tileSamples = samples;
+	}
+
+	GLint viewport[4], drawFramebuffer, readFramebuffer, packAlignment, packRowLength;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+	glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+	glGetIntegerv(GL_PACK_ROW_LENGTH, &packRowLength);
+
+	// with supersampling the tiles cover whole blocks of the larger
+	// rendered image, which is averaged down a band at a time
+	int factor = std::max(supersample, 1);
+	GLsizei renderWidth = width * factor;
+	GLsizei renderHeight = height * factor;
+	GLsizei step = tileSize - tileSize % factor;
+
+	// tiles are read straight into their place in a band of full width
+	// rows, which goes to disk once the whole row of tiles is done
+	GLsizei bandHeight = std::min(step, renderHeight);
+	std::vector<unsigned char> band(static_cast<size_t>(renderWidth) * bandHeight * 3);
+	std::vector<unsigned char> reduced(factor > 1 ? static_cast<size_t>(width) * (bandHeight / factor) * 3 : 0);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-	glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, &buf[0]);
+	glPixelStorei(GL_PACK_ROW_LENGTH, renderWidth);
+	glEnable(GL_DEPTH_TEST);
 
-	switch (format) {
-	case ImageFormats::PNG:
-		stbi_write_png(path, w, h, 3, &buf[0], 3 * w);
-		break;
-	case ImageFormats::BMP:
-		stbi_write_bmp(path, w, h, 3, &buf[0]);
-		break;
-	case ImageFormats::TGA:
-		stbi_write_tga(path, w, h, 3, &buf[0]);
-		break;
-	case ImageFormats::JPEG:
-		stbi_write_jpg(path, w, h, 3, &buf[0], 100);
-		break;
+	for (GLsizei y = 0; y < renderHeight; y += step) {
+		GLsizei tileHeight = std::min(step, renderHeight - y);
+		for (GLsizei x = 0; x < renderWidth; x += step) {
+			GLsizei tileWidth = std::min(step, renderWidth - x);
+			glBindFramebuffer(GL_FRAMEBUFFER, samples > 1 ? tileMsFbo : tileFbo);
+			glViewport(0, 0, tileWidth, tileHeight);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			drawTile(static_cast<float>(x) / renderWidth, static_cast<float>(y) / renderHeight,
+				static_cast<float>(tileWidth) / renderWidth, static_cast<float>(tileHeight) / renderHeight);
+
+			TRACE_SCOPE("readback");
+			if (samples > 1) {
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, tileFbo);
+				glBlitFramebuffer(0, 0, tileWidth, tileHeight, 0, 0, tileWidth, tileHeight,
+					GL_COLOR_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, tileFbo);
+			}
+			glReadPixels(0, 0, tileWidth, tileHeight, GL_RGB, GL_UNSIGNED_BYTE, band.data() + x * 3);
+		}
+
+		if (factor > 1) {
+			downsample(band.data(), width, tileHeight / factor, factor, reduced.data());
+			stream.writeRows(reduced.data(), tileHeight / factor);
+		}
+		else stream.writeRows(band.data(), tileHeight);
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, oldWidth, oldHeight);
+	glPixelStorei(GL_PACK_ROW_LENGTH, packRowLength);
+	glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	return stream.close();
+}
+
+GLsizei ImageExporter::maxCaptureSize() const {
+	return maxSize;
+}
+
+bool ImageExporter::formatFromPath(const std::string& path, ImageFormats& format) {
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos) return false;
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+	if (extension == "png") format = ImageFormats::PNG;
+	else if (extension == "bmp") format = ImageFormats::BMP;
+	else if (extension == "tga") format = ImageFormats::TGA;
+	else if (extension == "jpg" || extension == "jpeg") format = ImageFormats::JPEG;
+	else if (extension == "ppm") format = ImageFormats::PPM;
+	else if (extension == "pam") format = ImageFormats::PAM;
+	else if (extension == "raw") format = ImageFormats::RAW;
+	else return false;
+	return true;
+}
+
+GLsizei ImageExporter::sampleCount() const {
+	return std::max(1, std::min(samples, static_cast<int>(maxSamples)));
 }
 
 void ImageExporter::resize(GLsizei width, GLsizei height) {
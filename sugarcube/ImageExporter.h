@@ -2,25 +2,114 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <functional>
+#include <future>
+#include <list>
+#include <string>
+
 enum class ImageFormats {
 	BMP,
 	PNG,
 	TGA,
-	JPEG
+	JPEG,
+	// uncompressed, the rows go to disk straight from the readback buffer.
+	// RAW has no header at all, rgb24 frames for ffmpeg's rawvideo input
+	PPM,
+	PAM,
+	RAW
 };
 
+// renders into an offscreen framebuffer and saves it without stalling the
+// GL thread. Pixels are read into a pixel pack buffer behind a fence, once
+// the fence has passed the mapped buffer is encoded on the thread pool, and
+// the buffer is released when the encoder is done. poll() moves captures
+// along and has to be called regularly on the GL thread
 class ImageExporter {
 public:
 	ImageExporter(GLsizei width, GLsizei height);
 	void initialize();
 	void buildFramebuffer();
 	void beginCapture(GLsizei width, GLsizei height);
+	// starts the readback and restores the framebuffer and viewport that
+	// were bound before beginCapture
 	void saveImage(const char* path, ImageFormats format);
 	void resize(GLsizei width, GLsizei height);
 
+	// renders the image as a grid of tiles through one small framebuffer and
+	// streams each finished row of tiles to disk, so the output can be larger
+	// than the biggest framebuffer. drawTile renders the tile with the given
+	// rectangle, as fractions of the image from its top left corner, into
+	// the bound framebuffer. Blocks until the image is written
+	bool saveTiled(const char* path, ImageFormats format, GLsizei width, GLsizei height,
+		const std::function<void(float x, float y, float w, float h)>& drawTile);
+	// the largest width or height that fits in a single framebuffer
+	GLsizei maxCaptureSize() const;
+	// picks the format from the file extension, false if there is no match
+	static bool formatFromPath(const std::string& path, ImageFormats& format);
+
+	// returns true while captures are still being read back or encoded
+	bool poll();
+	// blocks until every capture has been written, false if any capture
+	// started since the exporter was last idle could not be saved
+	bool finish();
+	int pendingCount() const;
+	// fraction of the captures started since the exporter was last idle
+	// that have been written
+	float progress() const;
+
+	// deflate level of png exports, from 0 (stored) to 9 (smallest)
+	int pngCompression;
+	// anti-aliasing: samples per pixel of a multisampled framebuffer that is
+	// resolved before readback, 1 turns it off. Supersampling renders at
+	// that many times the output size and averages the pixels back down
+	// before encoding
+	int samples;
+	int supersample;
+
 private:
+	GLsizei sampleCount() const;
+
+	struct Capture {
+		GLuint pbo;
+		GLsync fence;
+		// size of the rendered image, factor times the size of the output
+		GLsizei width, height;
+		int factor;
+		std::string path;
+		ImageFormats format;
+		int compression;
+		void* pixels;
+		std::future<void> encoded;
+		// set by the encoder, captures stay in place in the list until it
+		// is done
+		bool written;
+	};
+
 	GLsizei w, h;
-	GLsizei oldWidth, oldHeight;
+	GLint savedViewport[4];
+	GLint savedDrawFramebuffer, savedReadFramebuffer;
 	GLuint fbo;
 	GLuint colorBuffer, depthBuffer;
+	GLsizei maxSize;
+	GLint maxSamples;
+
+	// multisampled framebuffer that is drawn into and resolved into fbo
+	// when samples is above 1
+	GLuint msFbo;
+	GLuint msColorBuffer, msDepthBuffer;
+	GLsizei builtSamples;
+	int captureFactor;
+
+	// built on the first tiled export and reused by every tile after that
+	GLsizei tileSize;
+	GLuint tileFbo;
+	GLuint tileColorBuffer, tileDepthBuffer;
+	GLuint tileMsFbo;
+	GLuint tileMsColorBuffer, tileMsDepthBuffer;
+	GLsizei tileSamples;
+
+	std::list<Capture> captures;
+	int started;
+	int finished;
+	int failed;
 };
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "ImageStream.h"
+#include "Deflate.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+// bytes of filtered rows compressed together, smaller pieces spread over
+// more threads but each one starts without a dictionary
+static const size_t PIECE_BYTES = 1 << 18;
+static const int BYTES_PER_PIXEL = 3;
+
+static std::array<uint32_t, 256> buildCrcTable() {
+	std::array<uint32_t, 256> table;
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		table[n] = c;
+	}
+	return table;
+}
+
+static const uint32_t* crcTable() {
+	static const std::array<uint32_t, 256> table = buildCrcTable();
+	return table.data();
+}
+
+static void putBigEndian(unsigned char* out, uint32_t value) {
+	out[0] = static_cast<unsigned char>(value >> 24);
+	out[1] = static_cast<unsigned char>(value >> 16);
+	out[2] = static_cast<unsigned char>(value >> 8);
+	out[3] = static_cast<unsigned char>(value);
+}
+
+static void putLittleEndian(unsigned char* out, uint32_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) out[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+static int paeth(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = std::abs(p - a);
+	int pb = std::abs(p - b);
+	int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	return pb <= pc ? b : c;
+}
+
+// png filter types 0 to 4 predict a byte from its left (a), upper (b) and
+// upper left (c) neighbors
+static int predict(int filter, int a, int b, int c) {
+	switch (filter) {
+	case 1: return a;
+	case 2: return b;
+	case 3: return (a + b) / 2;
+	case 4: return paeth(a, b, c);
+	default: return 0;
+	}
+}
+
+// writes the filter type and the filtered row to out. With adaptive
+// filtering every row uses the filter that leaves the smallest residuals,
+// which is what deflate compresses best. above is null for the first row
+static void filterRow(const unsigned char* row, const unsigned char* above, size_t bytes,
+	bool adaptive, unsigned char* out)
+{
+	int best = 0;
+	if (adaptive) {
+		long long costs[5] = {};
+		for (size_t x = 0; x < bytes; x++) {
+			int a = x >= BYTES_PER_PIXEL ? row[x - BYTES_PER_PIXEL] : 0;
+			int b = above ? above[x] : 0;
+			int c = above && x >= BYTES_PER_PIXEL ? above[x - BYTES_PER_PIXEL] : 0;
+			for (int filter = 0; filter < 5; filter++)
+				costs[filter] += std::abs(static_cast<signed char>(row[x] - predict(filter, a, b, c)));
+		}
+		best = static_cast<int>(std::min_element(costs, costs + 5) - costs);
+	}
+
+	out[0] = static_cast<unsigned char>(best);
+	for (size_t x = 0; x < bytes; x++) {
+		int a = x >= BYTES_PER_PIXEL ? row[x - BYTES_PER_PIXEL] : 0;
+		int b = above ? above[x] : 0;
+		int c = above && x >= BYTES_PER_PIXEL ? above[x - BYTES_PER_PIXEL] : 0;
+		out[x + 1] = static_cast<unsigned char>(row[x] - predict(best, a, b, c));
+	}
+}
+
+ImageStream::ImageStream() :
+	format(ImageFormats::PNG),
+	width(0), height(0),
+	rowsWritten(0),
+	compression(6),
+	crc(0),
+	adler(1)
+{}
+
+ImageStream::~ImageStream() {
+	if (file.is_open()) close();
+}
+
+bool ImageStream::open(const char* path, ImageFormats format, int width, int height, int compression) {
+	this->format = format;
+	this->width = width;
+	this->height = height;
+	this->compression = compression;
+	rowsWritten = 0;
+	adler = 1;
+
+	uint64_t bmpRow = (static_cast<uint64_t>(width) * 3 + 3) & ~static_cast<uint64_t>(3);
+	if (format == ImageFormats::JPEG) {
+		std::cout << "Error: jpg images can't be written in tiles, use another format" << std::endl;
+		return false;
+	}
+	if (format == ImageFormats::TGA && (width > 0xFFFF || height > 0xFFFF)) {
+		std::cout << "Error: tga images can't be larger than 65535 pixels" << std::endl;
+		return false;
+	}
+	if (format == ImageFormats::BMP && 54 + bmpRow * height > std::numeric_limits<uint32_t>::max()) {
+		std::cout << "Error: bmp images can't be larger than 4 GB" << std::endl;
+		return false;
+	}
+
+	file.open(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write image to path\n" << path << std::endl;
+		return false;
+	}
+
+	if (format == ImageFormats::PNG) {
+		// holds the last row written, the next band is filtered against it
+		row.resize(static_cast<size_t>(width) * 3);
+		const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		writeBytes(signature, sizeof(signature));
+
+		unsigned char header[13];
+		putBigEndian(header, width);
+		putBigEndian(header + 4, height);
+		header[8] = 8; // bits per channel
+		header[9] = 2; // rgb
+		header[10] = 0; // deflate
+		header[11] = 0; // adaptive filtering
+		header[12] = 0; // not interlaced
+		beginChunk("IHDR", sizeof(header));
+		writeChunkBytes(header, sizeof(header));
+		endChunk();
+
+		// zlib header, the compressed data follows in later chunks
+		const unsigned char zlibHeader[2] = { 0x78, 0x9C };
+		beginChunk("IDAT", sizeof(zlibHeader));
+		writeChunkBytes(zlibHeader, sizeof(zlibHeader));
+		endChunk();
+	}
+	else if (format == ImageFormats::BMP) {
+		// a negative height stores the rows top down
+		row.resize(static_cast<size_t>(bmpRow), 0);
+		unsigned char header[54] = { 'B', 'M' };
+		putLittleEndian(header + 2, static_cast<uint32_t>(54 + bmpRow * height), 4);
+		putLittleEndian(header + 10, 54, 4);
+		putLittleEndian(header + 14, 40, 4);
+		putLittleEndian(header + 18, width, 4);
+		putLittleEndian(header + 22, static_cast<uint32_t>(-height), 4);
+		putLittleEndian(header + 26, 1, 2);
+		putLittleEndian(header + 28, 24, 2);
+		writeBytes(header, sizeof(header));
+	}
+	else if (format == ImageFormats::PPM || format == ImageFormats::PAM) {
+		char header[128];
+		int length = format == ImageFormats::PPM ?
+			snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height) :
+			snprintf(header, sizeof(header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 3\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n", width, height);
+		writeBytes(header, length);
+	}
+	else if (format == ImageFormats::TGA) {
+		// uncompressed true color with the origin in the top left corner
+		row.resize(static_cast<size_t>(width) * 3);
+		unsigned char header[18] = {};
+		header[2] = 2;
+		putLittleEndian(header + 12, width, 2);
+		putLittleEndian(header + 14, height, 2);
+		header[16] = 24;
+		header[17] = 0x20;
+		writeBytes(header, sizeof(header));
+	}
+	return true;
+}
+
+void ImageStream::writeRows(const unsigned char* rows, int count) {
+	TRACE_SCOPE("writeRows");
+	count = std::min(count, height - rowsWritten);
+	size_t rowBytes = static_cast<size_t>(width) * 3;
+
+	if (format == ImageFormats::PNG) {
+		// pieces of whole rows are filtered and compressed in parallel, each
+		// ends in a sync flush so they join into one zlib stream
+		size_t filteredBytes = rowBytes + 1;
+		int pieceRows = static_cast<int>(std::max<size_t>(1, PIECE_BYTES / filteredBytes));
+		int pieceCount = (count + pieceRows - 1) / pieceRows;
+		std::vector<std::vector<uint8_t>> pieces(pieceCount);
+		std::vector<uint32_t> checksums(pieceCount);
+		const unsigned char* above = rowsWritten > 0 ? row.data() : nullptr;
+
+		ThreadPool::shared().parallelFor(0, pieceCount, [&](int piece) {
+			TRACE_SCOPE("deflate");
+			int first = piece * pieceRows;
+			int rowCount = std::min(pieceRows, count - first);
+			std::vector<uint8_t> filtered(filteredBytes * rowCount);
+			for (int y = first; y < first + rowCount; y++) {
+				filterRow(rows + y * rowBytes, y > 0 ? rows + (y - 1) * rowBytes : above,
+					rowBytes, compression > 0, filtered.data() + (y - first) * filteredBytes);
+			}
+			checksums[piece] = adler32(filtered.data(), filtered.size());
+			deflatePiece(filtered.data(), filtered.size(), compression, pieces[piece]);
+		});
+
+		for (int piece = 0; piece < pieceCount; piece++) {
+			int rowCount = std::min(pieceRows, count - piece * pieceRows);
+			adler = adler32Combine(adler, checksums[piece], filteredBytes * rowCount);
+			beginChunk("IDAT", static_cast<uint32_t>(pieces[piece].size()));
+			writeChunkBytes(pieces[piece].data(), pieces[piece].size());
+			endChunk();
+		}
+		if (count > 0) std::copy(rows + (count - 1) * rowBytes, rows + count * rowBytes, row.begin());
+	}
+	else if (format == ImageFormats::PPM || format == ImageFormats::PAM || format == ImageFormats::RAW) {
+		writeBytes(rows, rowBytes * count);
+	}
+	else {
+		// bmp and tga both store pixels as bgr
+		for (int y = 0; y < count; y++) {
+			const unsigned char* pixels = rows + y * rowBytes;
+			for (size_t x = 0; x < rowBytes; x += 3) {
+				row[x] = pixels[x + 2];
+				row[x + 1] = pixels[x + 1];
+				row[x + 2] = pixels[x];
+			}
+			writeBytes(row.data(), row.size());
+		}
+	}
+	rowsWritten += count;
+}
+
+bool ImageStream::close() {
+	if (format == ImageFormats::PNG) {
+		// an empty final stored block ends the deflate stream
+		unsigned char end[9] = { 1, 0, 0, 0xFF, 0xFF };
+		putBigEndian(end + 5, adler);
+		beginChunk("IDAT", sizeof(end));
+		writeChunkBytes(end, sizeof(end));
+		endChunk();
+		beginChunk("IEND", 0);
+		endChunk();
+	}
+
+	bool written = !file.fail();
+	file.close();
+	if (!written) std::cout << "Error: could not write the image" << std::endl;
+	else if (rowsWritten != height) {
+		std::cout << "Error: the image is missing " << height - rowsWritten << " rows" << std::endl;
+		written = false;
+	}
+	return written;
+}
+
+void ImageStream::writeBytes(const void* data, size_t size) {
+	file.write(static_cast<const char*>(data), size);
+}
+
+void ImageStream::writeChunkBytes(const void* data, size_t size) {
+	const uint32_t* table = crcTable();
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	writeBytes(data, size);
+}
+
+void ImageStream::beginChunk(const char* type, uint32_t length) {
+	unsigned char header[4];
+	putBigEndian(header, length);
+	writeBytes(header, sizeof(header));
+	// the crc covers the type and the data, but not the length
+	crc = 0xFFFFFFFFu;
+	writeChunkBytes(type, 4);
+}
+
+void ImageStream::endChunk() {
+	unsigned char footer[4];
+	putBigEndian(footer, crc ^ 0xFFFFFFFFu);
+	writeBytes(footer, sizeof(footer));
+}
\ No newline at end of file
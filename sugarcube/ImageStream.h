@@ -0,0 +1,43 @@
+#pragma once
+#include "ImageExporter.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// writes an image to disk a band of rows at a time, so images far larger
+// than memory can be saved. Rows are 8 bit RGB from the top of the image
+// down. Every format but JPEG can be streamed. PNG bands are filtered and
+// compressed in pieces across the thread pool, PPM, PAM and RAW rows are
+// written as they are
+class ImageStream {
+
+public:
+	ImageStream();
+	~ImageStream();
+
+	// compression is the png deflate level, 0 stores the pixels as they are,
+	// 1 is the fastest and 9 the smallest
+	bool open(const char* path, ImageFormats format, int width, int height, int compression = 6);
+	// rows are tightly packed, 3 bytes per pixel
+	void writeRows(const unsigned char* rows, int count);
+	// returns false if the file could not be written or is missing rows
+	bool close();
+
+private:
+	void writeBytes(const void* data, size_t size);
+	void writeChunkBytes(const void* data, size_t size);
+	void beginChunk(const char* type, uint32_t length);
+	void endChunk();
+
+	std::ofstream file;
+	ImageFormats format;
+	int width, height;
+	int rowsWritten;
+	int compression;
+	std::vector<unsigned char> row;
+
+	// running checksums of the current png chunk and of the zlib stream
+	uint32_t crc;
+	uint32_t adler;
+};
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+	data(nullptr),
+	size(0),
+#ifdef _WIN32
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr)
+#else
+	file(-1)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path) {
+	close();
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		close();
+		return false;
+	}
+	data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!data) {
+		close();
+		return false;
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char* path) {
+	close();
+	file = ::open(path, O_RDONLY);
+	if (file < 0) return false;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (mapped == MAP_FAILED) {
+		close();
+		return false;
+	}
+	data = static_cast<const unsigned char*>(mapped);
+	size = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) munmap(const_cast<unsigned char*>(data), size);
+	if (file >= 0) ::close(file);
+	data = nullptr;
+	size = 0;
+	file = -1;
+}
+
+#endif
\ No newline at end of file
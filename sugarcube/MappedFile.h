@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+
+// read only memory mapping of a whole file
+class MappedFile {
+
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	const unsigned char* data;
+	size_t size;
+
+private:
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+};
\ No newline at end of file
@@ -1,135 +1,127 @@
 #include "ObjExporter.h"
-#include <string>
+#include "GreedyMesher.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 #include <iostream>
-#include <fstream>
 
 ObjExporter::ObjExporter() {}
 
-ObjExporter::ObjExporter(std::vector<bool> data, ivec3 size) :
-	data(data),
-	size(size)
+ObjExporter::ObjExporter(GridView grid) :
+	grid(grid)
 {}
 
-void ObjExporter::load(std::vector<bool> data, ivec3 size) {
-	this->data = data;
-	this->size = size;
+void ObjExporter::load(GridView grid) {
+	this->grid = grid;
 }
 
-void ObjExporter::exportObj() {
-	if (data.size() == 0) {
+bool ObjExporter::exportObj(bool mergeFaces, const char* path) {
+	TRACE_SCOPE("exportObj");
+	if (!grid.isValid()) {
 		std::cout << "Can't export, no data" << std::endl;
-		return;
+		return false;
 	}
 
-	// create a list of vertices of visible faces
-	// skip those that are obscured by neighboring cubes
-	std::vector<Vertex> vertices;
-	for (int x = 0; x < size.x; x++) {
-		for (int y = 0; y < size.y; y++) {
-			for (int z = 0; z < size.z; z++) {
-				// skip empty cells
-				if (isEmpty(x, y, z)) continue;
-
-				// get coordinates of center point of cube
-				vec3 center(
-					static_cast<float>(x) - static_cast<float>(size.x - 1) * 0.5f,
-					static_cast<float>(y) - static_cast<float>(size.y - 1) * 0.5f,
-					static_cast<float>(z) - static_cast<float>(size.z - 1) * 0.5f
-				);
-
-				// check each orthographic neighbor
-				if (isEmpty(x - 1, y, z)) addFace(center, vec3(-1,  0,  0), vertices);
-				if (isEmpty(x + 1, y, z)) addFace(center, vec3( 1,  0,  0), vertices);
-				if (isEmpty(x, y - 1, z)) addFace(center, vec3( 0, -1,  0), vertices);
-				if (isEmpty(x, y + 1, z)) addFace(center, vec3( 0,  1,  0), vertices);
-				if (isEmpty(x, y, z - 1)) addFace(center, vec3( 0,  0, -1), vertices);
-				if (isEmpty(x, y, z + 1)) addFace(center, vec3( 0,  0,  1), vertices);
-			}
-		}
+	TextWriter obj;
+	if (!obj.open(path)) {
+		std::cout << "Error: could not open " << path << " for writing" << std::endl;
+		return false;
 	}
 
-	// write obj file
-	std::ofstream obj;
-	obj.open("export.obj");
-
-	obj << "# vertices\n";
-	for (int i = 0; i < vertices.size(); i++) {
-		obj << "v " << std::to_string(vertices[i].position.x)
-			<< "  " << std::to_string(vertices[i].position.y)
-			<< "  " << std::to_string(vertices[i].position.z) << "\n";
+	// face normals, written once as the only vn entries of the file
+	obj.write("# vertex normals\n");
+	for (int i = 0; i < 6; i++) {
+		obj.write("vn ");
+		obj.writeInt(faceNormals[i].x);
+		obj.write(' ');
+		obj.writeInt(faceNormals[i].y);
+		obj.write(' ');
+		obj.writeInt(faceNormals[i].z);
+		obj.write('\n');
 	}
 
-	obj << "\n# vertex normals\n";
-	for (int i = 0; i < vertices.size(); i++) {
-		obj << "vn " << std::to_string(vertices[i].normal.x)
-			<< "  " << std::to_string(vertices[i].normal.y)
-			<< "  " << std::to_string(vertices[i].normal.z) << "\n";
+	this->mergeFaces = mergeFaces;
+	vertexCount = 0;
+	std::vector<Quad> quads;
+
+	if (mergeFaces) {
+		// mesh a batch of slices in parallel, write it, then move on
+		GreedyMesher mesher(grid);
+		int batch = 4 * ThreadPool::shared().size();
+		for (int first = 0; first < mesher.sliceCount(); first += batch) {
+			quads.clear();
+			mesher.meshSlices(first, std::min(batch, mesher.sliceCount() - first), quads);
+			writeQuads(obj, quads);
+		}
+		cornerIndices.clear();
 	}
-
-	obj << "\n# faces\n";
-	for (int i = 0; i < vertices.size(); i += 4) {
-		obj << "f "
-			<< std::to_string(i + 1) << "//" << std::to_string(i + 1) << " "
-			<< std::to_string(i + 3) << "//" << std::to_string(i + 3) << " "
-			<< std::to_string(i + 4) << "//" << std::to_string(i + 4) << " "
-			<< std::to_string(i + 2) << "//" << std::to_string(i + 2) << " ";
-		obj << "\n";
+	else {
+		// faces are generated and written one z slab at a time, obj allows
+		// v and f lines to be interleaved as long as indices refer backwards,
+		// so memory use is bounded by the size of a single slab
+		size_t planeSize = (grid.size.x + 1) * (grid.size.y + 1);
+		lowerPlane.assign(planeSize, 0);
+		upperPlane.assign(planeSize, 0);
+
+		for (currentSlab = 0; currentSlab < grid.size.z; currentSlab++) {
+			quads.clear();
+			addSlabFaces(grid, currentSlab, quads);
+			writeQuads(obj, quads);
+
+			// the top of this slab is the bottom of the next one
+			std::swap(lowerPlane, upperPlane);
+			std::fill(upperPlane.begin(), upperPlane.end(), 0);
+		}
 	}
 
-	obj.close();
-}
-
-int ObjExporter::coordsToIndex(int x, int y, int z) {
-	return (z * size.x * size.y + y * size.x + x);
+	if (!obj.close()) {
+		std::cout << "Error: could not write " << path << std::endl;
+		return false;
+	}
+	return true;
 }
 
-bool ObjExporter::isEmpty(int x, int y, int z) {
-	if (x < 0 || x >= size.x ||
-		y < 0 || y >= size.y ||
-		z < 0 || z >= size.z)
-		return true;
+int& ObjExporter::cornerIndex(ivec3 corner) {
+	if (mergeFaces) {
+		long long key = (static_cast<long long>(corner.z) * (grid.size.y + 1) + corner.y) *
+			(grid.size.x + 1) + corner.x;
+		return cornerIndices[key];
+	}
 
-	return (!data[coordsToIndex(x, y, z)]);
+	std::vector<int>& plane = corner.z == currentSlab ? lowerPlane : upperPlane;
+	return plane[corner.y * (grid.size.x + 1) + corner.x];
 }
 
-void ObjExporter::addFace(vec3 center, vec3 normal, std::vector<Vertex>& vertices) {
-	// dot product of normal determines face orientation
-	// face orientation determines choice of tangents
-	// tangents are premultiplied by 0.5f for brevity
-	vec3 tangent1, tangent2;
-	if (glm::dot(normal, vec3(1, 0, 0)) != 0) {
-		tangent1 = vec3(0, 0.5f, 0);
-		tangent2 = vec3(0, 0,    0.5f);
-	}
-	else if (glm::dot(normal, vec3(0, 1, 0)) != 0) {
-		tangent2 = vec3(0.5f, 0, 0);
-		tangent1 = vec3(0,    0, 0.5f);
-	}
-	else if (glm::dot(normal, vec3(0, 0, 1)) != 0) {
-		tangent1 = vec3(0.5f, 0,    0);
-		tangent2 = vec3(0,    0.5f, 0);
+void ObjExporter::writeQuads(TextWriter& obj, const std::vector<Quad>& quads) {
+	if (quads.empty()) return;
+
+	// write each corner the first time a face uses it
+	obj.write("# vertices\n");
+	for (const Quad& quad : quads) {
+		for (int c = 0; c < 4; c++) {
+			int& index = cornerIndex(quad.corners[c]);
+			if (index != 0) continue;
+			index = ++vertexCount;
+
+			obj.write("v ");
+			obj.writeFloat(quad.corners[c].x - grid.size.x * 0.5f);
+			obj.write(' ');
+			obj.writeFloat(quad.corners[c].y - grid.size.y * 0.5f);
+			obj.write(' ');
+			obj.writeFloat(quad.corners[c].z - grid.size.z * 0.5f);
+			obj.write('\n');
+		}
 	}
 
-	// this weird bit of code is a quick way to reverse the winding
-	// order of a face if the normal is in a negative direction
-	if (normal.x + normal.y + normal.z < 0) {
-		tangent1 *= -1.0f;
+	obj.write("\n# faces\n");
+	for (const Quad& quad : quads) {
+		obj.write('f');
+		for (int c = 0; c < 4; c++) {
+			obj.write(' ');
+			obj.writeInt(cornerIndex(quad.corners[c]));
+			obj.write("//");
+			obj.writeInt(quad.normal + 1);
+		}
+		obj.write('\n');
 	}
-
-	// use tangents and normal vector to construct 4 vertices of face
-	Vertex v1, v2, v3, v4;
-	v1.position = center - tangent1 - tangent2 + normal * 0.5f;
-	v2.position = center - tangent1 + tangent2 + normal * 0.5f;
-	v3.position = center + tangent1 - tangent2 + normal * 0.5f;
-	v4.position = center + tangent1 + tangent2 + normal * 0.5f;
-
-	v1.normal = normal;
-	v2.normal = normal;
-	v3.normal = normal;
-	v4.normal = normal;
-
-	vertices.push_back(v1);
-	vertices.push_back(v2);
-	vertices.push_back(v3);
-	vertices.push_back(v4);
+	obj.write('\n');
 }
\ No newline at end of file
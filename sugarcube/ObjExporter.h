@@ -1,7 +1,12 @@
 #pragma once
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 
 #include <vector>
+#include <unordered_map>
+
+#include "GridView.h"
+#include "Quad.h"
+#include "TextWriter.h"
 
 using vec2 = glm::vec2;
 using vec3 = glm::vec3;
@@ -10,24 +15,29 @@ using vec4 = glm::vec4;
 
 class ObjExporter {
 
-public:
-	struct Vertex {
-		vec3 position;
-		vec3 normal;
-	};
-
 public:
 	ObjExporter();
-	ObjExporter(std::vector<bool> data, ivec3 size);
+	ObjExporter(GridView grid);
 
-	void load(std::vector<bool> data, ivec3 size);
-	void exportObj();
+	void load(GridView grid);
+	// merging faces runs the greedy mesher, which merges coplanar faces
+	// into larger rectangles
+	bool exportObj(bool mergeFaces = false, const char* path = "export.obj");
 
 private:
-	int coordsToIndex(int x, int y, int z);
-	bool isEmpty(int x, int y, int z);
-	void addFace(vec3 center, vec3 normal, std::vector<Vertex>& faces);
+	void writeQuads(TextWriter& obj, const std::vector<Quad>& quads);
+	int& cornerIndex(ivec3 corner);
+
+	GridView grid;
+	bool mergeFaces;
+	int currentSlab;
+	int vertexCount;
+
+	// obj index of each lattice corner in the bottom and top plane of the
+	// current slab, 0 for corners that haven't been written yet
+	std::vector<int> lowerPlane;
+	std::vector<int> upperPlane;
 
-	std::vector<bool> data;
-	ivec3 size;
+	// merged faces can span many slabs, so their corners are hashed instead
+	std::unordered_map<long long, int> cornerIndices;
 };
\ No newline at end of file
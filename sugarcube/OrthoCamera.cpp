@@ -51,6 +51,10 @@ void OrthoCamera::setAzimuth(float az) {
 	while (azimuth >= 360.0f) azimuth -= 360.0f;
 }
 
+float OrthoCamera::getAzimuth() {
+	return azimuth;
+}
+
 void OrthoCamera::setAltitude(float at) {
 	altitude = std::fmin(std::fmax(at, -89.9f), 89.9f);
 }
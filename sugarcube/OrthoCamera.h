@@ -1,7 +1,7 @@
 #pragma once
-#include <GLFW\glfw3.h>
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "Camera.h"
 
@@ -21,6 +21,7 @@ public:
 
 	void setSize(float w, float h);
 	void setAzimuth(float az);
+	float getAzimuth();
 	void setAltitude(float at);
 
 	float zoom;
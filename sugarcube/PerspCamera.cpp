@@ -42,6 +42,10 @@ void PerspCamera::setAzimuth(float az) {
 	while (azimuth >= 360.0f) azimuth -= 360.0f;
 }
 
+float PerspCamera::getAzimuth() {
+	return azimuth;
+}
+
 void PerspCamera::setAltitude(float at) {
 	altitude = std::fmin(std::fmax(at, -89.9f), 89.9f);
 }
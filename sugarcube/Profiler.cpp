@@ -0,0 +1,125 @@
+#include "Profiler.h"
+
+#if SUGARCUBE_PROFILE
+
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <thread>
+
+Profiler::Samples Profiler::samples[static_cast<int>(ProfileStage::Count)];
+GLuint Profiler::queries[2];
+bool Profiler::queryPending[2];
+int Profiler::currentQuery = 0;
+bool Profiler::queryActive = false;
+// no thread until setMainThread is called, nothing is recorded before that
+std::thread::id Profiler::mainThread;
+
+static const char* stageNames[] = {
+	"Frame",
+	"Step",
+	"Rebuild",
+	"Upload",
+	"Draw",
+	"Gui",
+	"Draw (GPU)"
+};
+
+void Profiler::setMainThread() {
+	mainThread = std::this_thread::get_id();
+}
+
+void Profiler::record(ProfileStage stage, double ms) {
+	// the panel shows per frame timings, work on background threads only
+	// shows up in the trace
+	if (std::this_thread::get_id() != mainThread) return;
+
+	Samples& s = samples[static_cast<int>(stage)];
+	s.values[s.next] = static_cast<float>(ms);
+	s.next = (s.next + 1) % WINDOW;
+	if (s.count < WINDOW) s.count++;
+}
+
+const char* Profiler::stageName(ProfileStage stage) {
+	return stageNames[static_cast<int>(stage)];
+}
+
+void Profiler::beginGpuTimer() {
+	if (queries[0] == 0) glGenQueries(2, queries);
+
+	// collect the result this query produced last time it was used, if
+	// it isn't ready yet skip timing this frame rather than waiting on it
+	GLuint query = queries[currentQuery];
+	if (queryPending[currentQuery]) {
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return;
+
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+		record(ProfileStage::GpuDraw, static_cast<double>(elapsed) / 1000000.0);
+		queryPending[currentQuery] = false;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	queryActive = true;
+}
+
+void Profiler::endGpuTimer() {
+	if (!queryActive) return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	queryPending[currentQuery] = true;
+	queryActive = false;
+	currentQuery = 1 - currentQuery;
+}
+
+void Profiler::drawPanel(bool* open) {
+	ImGui::SetNextWindowPos(ImVec2(10.0f, 140.0f), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Profiler", open, ImGuiWindowFlags_AlwaysAutoResize)) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Columns(4, "profilerStats");
+	ImGui::Text("Stage"); ImGui::NextColumn();
+	ImGui::Text("Min ms"); ImGui::NextColumn();
+	ImGui::Text("Avg ms"); ImGui::NextColumn();
+	ImGui::Text("P99 ms"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	float sorted[WINDOW];
+	for (int i = 0; i < static_cast<int>(ProfileStage::Count); i++) {
+		const Samples& s = samples[i];
+		ImGui::Text("%s", stageNames[i]); ImGui::NextColumn();
+		if (s.count == 0) {
+			ImGui::Text("-"); ImGui::NextColumn();
+			ImGui::Text("-"); ImGui::NextColumn();
+			ImGui::Text("-"); ImGui::NextColumn();
+			continue;
+		}
+
+		float total = 0.0f;
+		for (int j = 0; j < s.count; j++) {
+			sorted[j] = s.values[j];
+			total += s.values[j];
+		}
+		int p99 = (s.count * 99) / 100;
+		std::nth_element(sorted, sorted + p99, sorted + s.count);
+
+		ImGui::Text("%.3f", *std::min_element(s.values, s.values + s.count)); ImGui::NextColumn();
+		ImGui::Text("%.3f", total / s.count); ImGui::NextColumn();
+		ImGui::Text("%.3f", sorted[p99]); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+
+	// trace recording for offline analysis in perfetto / chrome://tracing
+	ImGui::Separator();
+	bool recording = Trace::isEnabled();
+	if (ImGui::Checkbox("Record trace", &recording)) Trace::setEnabled(recording);
+	ImGui::SameLine();
+	if (ImGui::Button("Save trace")) Trace::dump("trace.json");
+
+	ImGui::End();
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <thread>
+
+#include "Trace.h"
+
+enum class ProfileStage {
+	Frame,
+	Step,
+	Rebuild,
+	Upload,
+	Draw,
+	Gui,
+	GpuDraw,
+	Count
+};
+
+#if SUGARCUBE_PROFILE
+
+class Profiler {
+
+public:
+	// the panel only shows timings recorded on this thread, the one that
+	// draws the frame
+	static void setMainThread();
+	static void record(ProfileStage stage, double ms);
+	static void beginGpuTimer();
+	static void endGpuTimer();
+	static void drawPanel(bool* open);
+	static const char* stageName(ProfileStage stage);
+
+private:
+	// rolling window of samples for a single stage
+	static const int WINDOW = 240;
+	struct Samples {
+		float values[WINDOW];
+		int count;
+		int next;
+	};
+
+	static Samples samples[static_cast<int>(ProfileStage::Count)];
+
+	// two queries used alternately, so that the result being read is always
+	// from an earlier frame and never stalls the pipeline
+	static GLuint queries[2];
+	static bool queryPending[2];
+	static int currentQuery;
+	static bool queryActive;
+	static std::thread::id mainThread;
+};
+
+// records the time between construction and destruction as one sample
+class ScopedTimer {
+
+public:
+	ScopedTimer(ProfileStage stage) :
+		stage(stage),
+		start(std::chrono::high_resolution_clock::now()),
+		trace(Profiler::stageName(stage))
+	{}
+	~ScopedTimer() {
+		std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::high_resolution_clock::now() - start;
+		Profiler::record(stage, elapsed.count());
+	}
+
+private:
+	ProfileStage stage;
+	std::chrono::high_resolution_clock::time_point start;
+	// the stage also shows up in the trace
+	ScopedTrace trace;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(stage) ScopedTimer PROFILE_CONCAT(scopedTimer, __LINE__)(stage)
+#define PROFILE_GPU_BEGIN() Profiler::beginGpuTimer()
+#define PROFILE_GPU_END() Profiler::endGpuTimer()
+
+#else
+
+#define PROFILE_SCOPE(stage)
+#define PROFILE_GPU_BEGIN()
+#define PROFILE_GPU_END()
+
+#endif
\ No newline at end of file
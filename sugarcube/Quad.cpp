@@ -0,0 +1,57 @@
+#include "Quad.h"
+
+const ivec3 faceNormals[6] = {
+	ivec3(-1,  0,  0),
+	ivec3( 1,  0,  0),
+	ivec3( 0, -1,  0),
+	ivec3( 0,  1,  0),
+	ivec3( 0,  0, -1),
+	ivec3( 0,  0,  1)
+};
+
+Quad makeQuad(ivec3 cell, int normal, int width, int height) {
+	int axis = normal / 2;
+	bool positive = (normal % 2) == 1;
+	ivec3 u(0), v(0);
+	u[(axis + 1) % 3] = width;
+	v[(axis + 2) % 3] = height;
+
+	// faces pointing in the positive direction lie on the far side of the cell
+	ivec3 origin = cell;
+	if (positive) origin[axis] += 1;
+
+	Quad quad;
+	quad.normal = normal;
+	if (positive) {
+		quad.corners[0] = origin;
+		quad.corners[1] = origin + u;
+		quad.corners[2] = origin + u + v;
+		quad.corners[3] = origin + v;
+	}
+	// reversing the first tangent reverses the winding for negative faces
+	else {
+		quad.corners[0] = origin + u;
+		quad.corners[1] = origin;
+		quad.corners[2] = origin + v;
+		quad.corners[3] = origin + u + v;
+	}
+	return quad;
+}
+
+void addSlabFaces(const GridView& grid, int z, std::vector<Quad>& quads) {
+	// create a list of visible faces
+	// skip those that are obscured by neighboring cubes
+	for (int y = 0; y < grid.size.y; y++) {
+		for (int x = 0; x < grid.size.x; x++) {
+			// skip empty cells
+			if (grid.isEmpty(x, y, z)) continue;
+
+			// check each orthographic neighbor
+			for (int n = 0; n < 6; n++) {
+				ivec3 neighbor = ivec3(x, y, z) + faceNormals[n];
+				if (grid.isEmpty(neighbor.x, neighbor.y, neighbor.z))
+					quads.push_back(makeQuad(ivec3(x, y, z), n));
+			}
+		}
+	}
+}
\ No newline at end of file
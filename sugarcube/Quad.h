@@ -0,0 +1,27 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "GridView.h"
+
+using ivec3 = glm::ivec3;
+
+// axis aligned face with its corners given as points on the lattice of
+// cube corners, which runs from 0 to size on each axis, wound counter
+// clockwise when seen from the side the normal points to
+struct Quad {
+	ivec3 corners[4];
+	int normal;
+};
+
+// the six face directions, indexed by Quad::normal
+extern const ivec3 faceNormals[6];
+
+// face of a cell facing the given direction, stretched to cover width
+// cells along the first tangent and height cells along the second; the
+// tangents of a face on axis a are the axes (a + 1) % 3 and (a + 2) % 3
+Quad makeQuad(ivec3 cell, int normal, int width = 1, int height = 1);
+
+// appends one unit quad for every visible face of the cells in z slab z
+void addSlabFaces(const GridView& grid, int z, std::vector<Quad>& quads);
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "RunArchive.h"
+#include "CellPacking.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+static const char MAGIC[4] = { 'S', 'G', 'R', 'A' };
+static const char FOOTER_MAGIC[4] = { 'S', 'G', 'R', 'I' };
+static const uint32_t VERSION = 1;
+
+enum RecordType : uint8_t {
+	Keyframe,
+	Changes
+};
+
+struct ArchiveHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t size[3];
+	int32_t rule[4];
+	int32_t keyframeInterval;
+	int32_t firstGeneration;
+};
+
+struct ArchiveFooter {
+	uint64_t indexOffset;
+	uint32_t records;
+	char magic[4];
+};
+
+// each record is its type and data size followed by the data
+static const size_t RECORD_HEADER = 1 + sizeof(uint32_t);
+// generations waiting for the writer before append blocks, so a disk
+// slower than the simulation can't fill memory with copied grids
+static const size_t MAX_QUEUED_JOBS = 64;
+
+ArchiveWriter::ArchiveWriter() :
+	closing(false),
+	recording(false),
+	failed(false),
+	written(0),
+	keyframeInterval(64),
+	lastGeneration(0),
+	generations(0)
+{}
+
+ArchiveWriter::~ArchiveWriter() {
+	close();
+}
+
+bool ArchiveWriter::open(const char* path, const Automata3D& simulation, int keyframeInterval) {
+	close();
+	file.open(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+
+	ivec3 size = simulation.getSize();
+	this->keyframeInterval = std::max(keyframeInterval, 1);
+	ArchiveHeader header = {
+		{ MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3] }, VERSION,
+		{ size.x, size.y, size.z },
+		{ simulation.eL, simulation.eU, simulation.fL, simulation.fU },
+		this->keyframeInterval, simulation.getGeneration()
+	};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (!file) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	offsets.clear();
+	jobs.clear();
+	closing = false;
+	recording = true;
+	failed = false;
+	written = 0;
+	generations = 0;
+	lastGeneration = simulation.getGeneration() - 1;
+	writer = std::thread(&ArchiveWriter::write, this);
+	append(simulation);
+	return true;
+}
+
+void ArchiveWriter::append(const Automata3D& simulation) {
+	if (!recording) return;
+	if (failed) {
+		close();
+		return;
+	}
+	if (simulation.getGeneration() != lastGeneration + 1) {
+		std::cout << "Recording stopped, the simulation jumped to generation " <<
+			simulation.getGeneration() << std::endl;
+		close();
+		return;
+	}
+
+	Job job;
+	job.keyframe = generations % keyframeInterval == 0;
+	if (job.keyframe) job.cells = simulation.cells;
+	else job.changes = simulation.getChanges();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		drained.wait(lock, [this] { return jobs.size() < MAX_QUEUED_JOBS || failed; });
+		jobs.push_back(std::move(job));
+	}
+	wake.notify_one();
+	lastGeneration++;
+	generations++;
+}
+
+void ArchiveWriter::write() {
+	TRACE_THREAD_NAME("archive writer");
+	uint64_t offset = sizeof(ArchiveHeader);
+	std::vector<uint8_t> packed;
+	std::vector<uint8_t> data;
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return closing || !jobs.empty(); });
+			if (jobs.empty()) break;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		drained.notify_one();
+
+		TRACE_SCOPE("writeRecord");
+		data.clear();
+		RecordType type = job.keyframe ? Keyframe : Changes;
+		if (job.keyframe) {
+			packed.resize((job.cells.size() + 7) / 8);
+			packCells(job.cells, 0, job.cells.size(), packed.data());
+			encodeZeroRuns(packed.data(), packed.size(), data);
+		}
+		else {
+			encodeChangeList(std::move(job.changes), data);
+		}
+
+		uint32_t bytes = static_cast<uint32_t>(data.size());
+		file.put(static_cast<char>(type));
+		file.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file) break;
+		offsets.push_back(offset);
+		offset += RECORD_HEADER + data.size();
+		written++;
+	}
+
+	if (file) {
+		ArchiveFooter footer = { offset, static_cast<uint32_t>(offsets.size()),
+			{ FOOTER_MAGIC[0], FOOTER_MAGIC[1], FOOTER_MAGIC[2], FOOTER_MAGIC[3] } };
+		file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+		file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+	}
+	file.close();
+	if (!file) {
+		// the records that made it are still read back by scanning, drop
+		// the rest and let append stop waiting for room
+		std::lock_guard<std::mutex> lock(mutex);
+		failed = true;
+		jobs.clear();
+	}
+	drained.notify_all();
+}
+
+bool ArchiveWriter::close() {
+	if (!writer.joinable()) return !failed;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	wake.notify_one();
+	writer.join();
+	recording = false;
+	if (failed) {
+		std::cout << "Error: could not write the run archive, recording stopped after " <<
+			written << " generations" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ArchiveWriter::isOpen() const {
+	return recording && !failed;
+}
+
+int ArchiveWriter::recordedGenerations() const {
+	return written;
+}
+
+ArchiveReader::ArchiveReader() :
+	size(0),
+	eL(0), eU(0), fL(0), fU(0),
+	keyframeInterval(1),
+	first(0),
+	records(0),
+	index(nullptr)
+{}
+
+bool ArchiveReader::open(const char* path) {
+	close();
+	if (!file.open(path)) {
+		std::cout << "Error: could not open file\n" << path << std::endl;
+		return false;
+	}
+
+	ArchiveHeader header;
+	if (file.size < sizeof(header) ||
+		std::memcmp(file.data, MAGIC, 4) != 0)
+	{
+		std::cout << "Error: not a run archive\n" << path << std::endl;
+		close();
+		return false;
+	}
+	std::memcpy(&header, file.data, sizeof(header));
+	if (header.version > VERSION) {
+		std::cout << "Error: archive version " << header.version <<
+			" is newer than this build supports\n" << path << std::endl;
+		close();
+		return false;
+	}
+	// the grid is allocated from these before any record is read, and cells
+	// are addressed with an int
+	if (header.size[0] < 1 || header.size[1] < 1 || header.size[2] < 1 ||
+		static_cast<int64_t>(header.size[0]) * header.size[1] * header.size[2] > INT_MAX)
+	{
+		std::cout << "Error: the archive has an invalid grid size\n" << path << std::endl;
+		close();
+		return false;
+	}
+	size = ivec3(header.size[0], header.size[1], header.size[2]);
+	eL = header.rule[0];
+	eU = header.rule[1];
+	fL = header.rule[2];
+	fU = header.rule[3];
+	keyframeInterval = std::max(header.keyframeInterval, 1);
+	first = header.firstGeneration;
+
+	// use the trailing index when the footer is intact and every record it
+	// points to lies between the header and the index
+	ArchiveFooter footer;
+	uint64_t recordsEnd = file.size;
+	if (file.size >= sizeof(header) + sizeof(footer)) {
+		std::memcpy(&footer, file.data + file.size - sizeof(footer), sizeof(footer));
+		uint64_t indexEnd = file.size - sizeof(footer);
+		bool hasFooter = std::memcmp(footer.magic, FOOTER_MAGIC, 4) == 0 &&
+			footer.indexOffset >= sizeof(header) && footer.indexOffset <= indexEnd;
+		// a scan must not read the index itself as records
+		if (hasFooter) recordsEnd = footer.indexOffset;
+		if (hasFooter && footer.records > 0 &&
+			footer.records == (indexEnd - footer.indexOffset) / sizeof(uint64_t) &&
+			(indexEnd - footer.indexOffset) % sizeof(uint64_t) == 0)
+		{
+			index = file.data + footer.indexOffset;
+			records = footer.records;
+			bool valid = true;
+			for (size_t record = 0; record < records && valid; record++) {
+				uint64_t offset = recordOffset(record);
+				uint32_t bytes = 0;
+				valid = offset >= sizeof(header) && offset <= footer.indexOffset &&
+					RECORD_HEADER <= footer.indexOffset - offset;
+				if (valid) std::memcpy(&bytes, file.data + offset + 1, sizeof(bytes));
+				valid = valid && bytes <= footer.indexOffset - offset - RECORD_HEADER;
+			}
+			if (valid) return true;
+			std::cout << "Archive index is damaged, scanning the records instead" << std::endl;
+			index = nullptr;
+			records = 0;
+		}
+	}
+
+	// otherwise walk the records, stopping at the first incomplete one
+	uint64_t offset = sizeof(header);
+	while (offset + RECORD_HEADER <= recordsEnd) {
+		uint32_t bytes;
+		std::memcpy(&bytes, file.data + offset + 1, sizeof(bytes));
+		if (offset + RECORD_HEADER + bytes > recordsEnd) break;
+		scannedIndex.push_back(offset);
+		offset += RECORD_HEADER + bytes;
+	}
+	records = scannedIndex.size();
+	if (records == 0) {
+		std::cout << "Error: the archive holds no generations\n" << path << std::endl;
+		close();
+		return false;
+	}
+	std::cout << "Archive has no index, recovered " << records << " generations" << std::endl;
+	return true;
+}
+
+void ArchiveReader::close() {
+	file.close();
+	index = nullptr;
+	records = 0;
+	scannedIndex.clear();
+}
+
+bool ArchiveReader::isOpen() const {
+	return records > 0;
+}
+
+int ArchiveReader::firstGeneration() const {
+	return first;
+}
+
+int ArchiveReader::lastGeneration() const {
+	return first + static_cast<int>(records) - 1;
+}
+
+uint64_t ArchiveReader::recordOffset(size_t record) const {
+	if (!index) return scannedIndex[record];
+	uint64_t offset;
+	std::memcpy(&offset, index + record * sizeof(uint64_t), sizeof(offset));
+	return offset;
+}
+
+bool ArchiveReader::recordData(size_t record, uint8_t& type, const uint8_t*& data, uint32_t& bytes) const {
+	uint64_t offset = recordOffset(record);
+	if (offset + RECORD_HEADER > file.size) return false;
+	type = file.data[offset];
+	std::memcpy(&bytes, file.data + offset + 1, sizeof(bytes));
+	if (offset + RECORD_HEADER + bytes > file.size) return false;
+	data = file.data + offset + RECORD_HEADER;
+	return true;
+}
+
+bool ArchiveReader::decodeKeyframe(const uint8_t* data, uint32_t bytes, std::vector<bool>& cells) const {
+	size_t cellCount = static_cast<size_t>(size.x) * size.y * size.z;
+	std::vector<uint8_t> packed((cellCount + 7) / 8);
+	if (!decodeZeroRuns(data, bytes, packed.data(), packed.size())) return false;
+	cells.resize(cellCount);
+	unpackCells(packed.data(), 0, cellCount, cells);
+	return true;
+}
+
+bool ArchiveReader::readRecord(size_t record, std::vector<bool>& cells) const {
+	uint8_t type;
+	const uint8_t* data;
+	uint32_t bytes;
+	if (!recordData(record, type, data, bytes)) return false;
+
+	if (type == Keyframe) return decodeKeyframe(data, bytes, cells);
+	if (type == Changes) return applyChangeList(data, bytes, cells);
+	return false;
+}
+
+bool ArchiveReader::seek(int generation, std::vector<bool>& cells) const {
+	TRACE_SCOPE("seekArchive");
+	if (generation < first || generation > lastGeneration()) return false;
+
+	// keyframes sit at fixed intervals from the start of the archive
+	size_t target = generation - first;
+	size_t keyframe = target - target % keyframeInterval;
+	if (file.data[recordOffset(keyframe)] != Keyframe) return false;
+	for (size_t record = keyframe; record <= target; record++) {
+		if (!readRecord(record, cells)) return false;
+	}
+	return true;
+}
+
+bool ArchiveReader::advance(int generation, std::vector<bool>& cells) const {
+	if (generation <= first || generation > lastGeneration()) return false;
+	return readRecord(generation - first, cells);
+}
+
+bool ArchiveReader::readChanges(int generation, const std::vector<bool>& cells, std::vector<int>& changes) const {
+	if (generation <= first || generation > lastGeneration()) return false;
+	size_t cellCount = static_cast<size_t>(size.x) * size.y * size.z;
+	if (cells.size() != cellCount) return false;
+
+	uint8_t type;
+	const uint8_t* data;
+	uint32_t bytes;
+	if (!recordData(generation - first, type, data, bytes)) return false;
+
+	if (type == Changes) return decodeChangeList(data, bytes, cellCount, changes);
+	if (type != Keyframe) return false;
+	std::vector<bool> next;
+	if (!decodeKeyframe(data, bytes, next)) return false;
+	changes.clear();
+	for (size_t i = 0; i < cellCount; i++) {
+		if (next[i] != cells[i]) changes.push_back(static_cast<int>(i));
+	}
+	return true;
+}
+
+bool ArchiveReader::restore(int generation, Automata3D& simulation) const {
+	std::vector<bool> cells;
+	if (!seek(generation, cells)) {
+		std::cout << "Error: could not read generation " << generation << " from the archive" << std::endl;
+		return false;
+	}
+	simulation.eL = eL;
+	simulation.eU = eU;
+	simulation.fL = fL;
+	simulation.fU = fU;
+	simulation.setState(size, generation, std::move(cells));
+	return true;
+}
\ No newline at end of file
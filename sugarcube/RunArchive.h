@@ -0,0 +1,112 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Automata3D.h"
+#include "MappedFile.h"
+
+using ivec3 = glm::ivec3;
+
+// append only log of every generation of a run. After the header come the
+// generations in order, each a record holding either a keyframe (the packed,
+// zero run encoded grid) or the change list of its step. Keyframes are
+// written every keyframeInterval generations. Closing the archive appends an
+// index of record offsets and a footer, so any generation is one lookup and
+// at most keyframeInterval change lists away
+
+class ArchiveWriter {
+
+public:
+	ArchiveWriter();
+	~ArchiveWriter();
+
+	// starts the archive with the simulation's current generation
+	bool open(const char* path, const Automata3D& simulation, int keyframeInterval = 64);
+	// records the generation the simulation just stepped to. The grid or
+	// change list is copied and handed to the writer thread, so the caller
+	// only waits on the disk when it falls far behind. Anything but the
+	// next generation, or a failed write, ends the recording
+	void append(const Automata3D& simulation);
+	// waits for the queued generations to be written, then writes the
+	// index. False if anything couldn't be written, until the next open
+	bool close();
+	// false as soon as a write has failed
+	bool isOpen() const;
+	// generations that have reached the file
+	int recordedGenerations() const;
+
+private:
+	struct Job {
+		bool keyframe;
+		std::vector<bool> cells;
+		std::vector<int> changes;
+	};
+
+	void write();
+
+	std::ofstream file;
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable drained;
+	std::deque<Job> jobs;
+	bool closing;
+	bool recording;
+	// set by the writer thread, which stops taking jobs after a failure
+	std::atomic<bool> failed;
+	std::atomic<int> written;
+
+	int keyframeInterval;
+	int lastGeneration;
+	int generations;
+	// only touched by the writer thread until it has been joined
+	std::vector<uint64_t> offsets;
+};
+
+class ArchiveReader {
+
+public:
+	ArchiveReader();
+
+	// archives that were never closed have no index, their records are
+	// scanned instead
+	bool open(const char* path);
+	void close();
+	bool isOpen() const;
+
+	int firstGeneration() const;
+	int lastGeneration() const;
+	bool seek(int generation, std::vector<bool>& cells) const;
+	// moves cells from the generation before to this one, one record read
+	bool advance(int generation, std::vector<bool>& cells) const;
+	// the cells that flip going to this generation from cells, which must
+	// hold the generation before. Keyframes are compared against cells
+	bool readChanges(int generation, const std::vector<bool>& cells, std::vector<int>& changes) const;
+	// seeks and loads the generation and the archive's rule into the simulation
+	bool restore(int generation, Automata3D& simulation) const;
+
+	ivec3 size;
+	int eL, eU, fL, fU;
+	int keyframeInterval;
+
+private:
+	bool recordData(size_t record, uint8_t& type, const uint8_t*& data, uint32_t& bytes) const;
+	bool decodeKeyframe(const uint8_t* data, uint32_t bytes, std::vector<bool>& cells) const;
+	bool readRecord(size_t record, std::vector<bool>& cells) const;
+	uint64_t recordOffset(size_t record) const;
+
+	MappedFile file;
+	int first;
+	size_t records;
+	const unsigned char* index;
+	std::vector<uint64_t> scannedIndex;
+};
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstring>
 
 Shader& Shader::use() {
 	glUseProgram(id);
@@ -77,6 +78,7 @@ void Shader::compile(const GLchar* vertSource, const GLchar* fragSource,
 	if (geoSource != nullptr) glAttachShader(id, sGeo);
 	glLinkProgram(id);
 	checkCompileErrors(id, "PROGRAM");
+	reflectUniforms();
 
 	// discard shader objects after linking
 	glDeleteShader(sVert);
@@ -86,47 +88,91 @@ void Shader::compile(const GLchar* vertSource, const GLchar* fragSource,
 
 void Shader::setFloat(const GLchar* name, GLfloat value, GLboolean useShader) {
 	if (useShader) this->use();
-	glUniform1f(glGetUniformLocation(id, name), value);
+	Uniform* uniform = changedUniform(name, &value, sizeof(value));
+	if (uniform) glUniform1f(uniform->location, value);
 }
 
 void Shader::setInt(const GLchar* name, GLint value, GLboolean useShader) {
 	if (useShader) this->use();
-	glUniform1i(glGetUniformLocation(id, name), value);
+	Uniform* uniform = changedUniform(name, &value, sizeof(value));
+	if (uniform) glUniform1i(uniform->location, value);
 }
 
 void Shader::setVec2(const GLchar* name, GLfloat x, GLfloat y, GLboolean useShader) {
-	if (useShader) this->use();
-	glUniform2f(glGetUniformLocation(id, name), x, y);
+	setVec2(name, glm::vec2(x, y), useShader);
 }
 
 void Shader::setVec2(const GLchar* name, const glm::vec2& value, GLboolean useShader) {
 	if (useShader) this->use();
-	glUniform2f(glGetUniformLocation(id, name), value.x, value.y);
+	Uniform* uniform = changedUniform(name, &value, sizeof(value));
+	if (uniform) glUniform2f(uniform->location, value.x, value.y);
 }
 
 void Shader::setVec3(const GLchar* name, GLfloat x, GLfloat y, GLfloat z, GLboolean useShader) {
-	if (useShader) this->use();
-	glUniform3f(glGetUniformLocation(id, name), x, y, z);
+	setVec3(name, glm::vec3(x, y, z), useShader);
 }
 
 void Shader::setVec3(const GLchar* name, const glm::vec3& value, GLboolean useShader) {
 	if (useShader) this->use();
-	glUniform3f(glGetUniformLocation(id, name), value.x, value.y, value.z);
+	Uniform* uniform = changedUniform(name, &value, sizeof(value));
+	if (uniform) glUniform3f(uniform->location, value.x, value.y, value.z);
 }
 
 void Shader::setVec4(const GLchar* name, GLfloat r, GLfloat g, GLfloat b, GLfloat a, GLboolean useShader) {
-	if (useShader) this->use();
-	glUniform4f(glGetUniformLocation(id, name), r, g, b, a);
+	setVec4(name, glm::vec4(r, g, b, a), useShader);
 }
 
 void Shader::setVec4(const GLchar* name, const glm::vec4& value, GLboolean useShader) {
 	if (useShader) this->use();
-	glUniform4f(glGetUniformLocation(id, name), value.r, value.g, value.b, value.a);
+	Uniform* uniform = changedUniform(name, &value, sizeof(value));
+	if (uniform) glUniform4f(uniform->location, value.r, value.g, value.b, value.a);
 }
 
 void Shader::setMat4(const GLchar* name, const glm::mat4& value, GLboolean useShader) {
 	if (useShader) this->use();
-	glUniformMatrix4fv(glGetUniformLocation(id, name), 1, GL_FALSE, glm::value_ptr(value));
+	Uniform* uniform = changedUniform(name, &value, sizeof(value));
+	if (uniform) glUniformMatrix4fv(uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::bindUniformBlock(const GLchar* name, GLuint binding) {
+	GLuint index = glGetUniformBlockIndex(id, name);
+	if (index != GL_INVALID_INDEX) glUniformBlockBinding(id, index, binding);
+}
+
+void Shader::reflectUniforms() {
+	uniforms.clear();
+
+	GLint count;
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i = 0; i < count; i++) {
+		GLchar name[256];
+		GLsizei length;
+		GLint size;
+		Uniform uniform;
+		glGetActiveUniform(id, i, sizeof(name), &length, &size, &uniform.type, name);
+
+		// members of uniform blocks have no location of their own
+		uniform.location = glGetUniformLocation(id, name);
+		if (uniform.location == -1) continue;
+		uniform.hasValue = false;
+
+		// arrays are reported as "name[0]", store them under the plain name
+		std::string key(name, length);
+		if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+			key.resize(key.size() - 3);
+		uniforms[key] = uniform;
+	}
+}
+
+Shader::Uniform* Shader::changedUniform(const GLchar* name, const void* value, size_t bytes) {
+	auto it = uniforms.find(name);
+	if (it == uniforms.end()) return nullptr;
+
+	Uniform& uniform = it->second;
+	if (uniform.hasValue && std::memcmp(uniform.value, value, bytes) == 0) return nullptr;
+	std::memcpy(uniform.value, value, bytes);
+	uniform.hasValue = true;
+	return &uniform;
 }
 
 void Shader::checkCompileErrors(GLuint object, std::string type) {
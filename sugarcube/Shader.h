@@ -1,13 +1,24 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 
-#include <glad\glad.h>
-#include <glm\glm.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 class Shader {
 
+public:
+	// active uniform reflected from the linked program, along with the last
+	// value sent to it so that unchanged values can be skipped
+	struct Uniform {
+		GLint location;
+		GLenum type;
+		bool hasValue;
+		unsigned char value[sizeof(glm::mat4)];
+	};
+
 public:
 	Shader() {}
 
@@ -26,9 +37,14 @@ public:
 	void setVec4(const GLchar* name, GLfloat r, GLfloat g, GLfloat b, GLfloat a, GLboolean useShader = false);
 	void setVec4(const GLchar* name, const glm::vec4& value, GLboolean useShader = false);
 	void setMat4(const GLchar* name, const glm::mat4& value, GLboolean useShader = false);
+	void bindUniformBlock(const GLchar* name, GLuint binding);
 
 	GLuint id;
 
 private:
 	void checkCompileErrors(GLuint object, std::string type);
+	void reflectUniforms();
+	Uniform* changedUniform(const GLchar* name, const void* value, size_t bytes);
+
+	std::unordered_map<std::string, Uniform> uniforms;
 };
\ No newline at end of file
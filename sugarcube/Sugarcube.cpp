@@ -1,12 +1,16 @@
 #include "Sugarcube.h"
 #include "Tooltips.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
-#include <nativefiledialog\nfd.h>
+#include <nativefiledialog/nfd.h>
 
 Sugarcube::Sugarcube(float screenWidth, float screenHeight, float sidebarWidth) :
 	screen(screenWidth, screenHeight),
 	sidebarWidth(sidebarWidth),
 	simulation(ivec3(16), 4, 5, 2, 6),
+	importedSize(0),
 	camera(nullptr),
 	imageExporter(1024, 1024),
 	elapsed(0),
@@ -17,6 +21,7 @@ Sugarcube::Sugarcube(float screenWidth, float screenHeight, float sidebarWidth)
 	smoothLight(1),
 	cameraRampScale(0.5f),
 	cameraRampOffset(0.5f),
+	occlusionStrength(0.5f),
 	originRampScale(13.86f),
 	originRampOffset(0.0f),
 	nearColor(vec4(1.0f)),
@@ -31,32 +36,255 @@ Sugarcube::Sugarcube(float screenWidth, float screenHeight, float sidebarWidth)
 	lightAltitude(60.0f),
 	normalMix(1.0f),
 	lightMix(0.5f),
-	playing(false)
+	playing(false),
+	redrawFrames(0),
+	showProfiler(false),
+	mergeWhenPaused(false),
+	sequence()
 {}
 
+// imgui needs a couple of frames to settle after an input event
+// (hover states, popups opening) before the screen is up to date
+static const int REDRAW_FRAMES = 3;
+
 void Sugarcube::initialize() {
+#if SUGARCUBE_PROFILE
+	Profiler::setMainThread();
+#endif
+
 	// load shaders
 	normalShader.loadFromFile("shaders/voxel.vs", "shaders/normal.fs");
 	rampShader.loadFromFile("shaders/voxel.vs", "shaders/ramp.fs");
 	rampShader.use();
 
+	// uniform blocks shared by both shaders
+	cameraUniforms.initialize(0, sizeof(CameraBlock));
+	shadingUniforms.initialize(1, sizeof(ShadingBlock));
+	normalShader.bindUniformBlock("Camera", 0);
+	normalShader.bindUniformBlock("Shading", 1);
+	rampShader.bindUniformBlock("Camera", 0);
+	rampShader.bindUniformBlock("Shading", 1);
+
 	// initialize simulation
 	simulation.initRenderData();
 	simulation.createBox(ivec3(6));
 
 	// initialize image exporter
 	imageExporter.initialize();
+
+	requestRedraw();
 }
 
 void Sugarcube::update(float dt) {
+	simulation.useStaticMesh = mergeWhenPaused && !playing;
+
+	// keep drawing while images are saved in the background, so that the
+	// progress bar moves and finished readbacks are picked up
+	if (imageExporter.poll()) requestRedraw();
+	// the same while a sweep runs, whether or not its panel is open, so the
+	// results show up as soon as it ends
+	if (sweep.isRunning()) requestRedraw();
+
+	if (sequence.active) {
+		exportSequenceFrame();
+		requestRedraw();
+		return;
+	}
+
+	// don't bank time while paused, or playback would race to catch up
+	if (!playing) {
+		elapsed = 0;
+		return;
+	}
+
 	elapsed += dt;
 	if (elapsed > 1.0f / playSpeed) {
 		elapsed -= (1.0f / playSpeed);
-		if (playing) simulation.step();
+		stepSimulation();
+		requestRedraw();
+	}
+}
+
+void Sugarcube::stepSimulation() {
+	// while a run archive is open its generations are replayed, the
+	// simulation takes over again after the last one
+	int next = simulation.getGeneration() + 1;
+	if (archive.isOpen() && simulation.getSize() == archive.size &&
+		next > archive.firstGeneration() && next <= archive.lastGeneration()) {
+		std::vector<int> changes;
+		if (archive.readChanges(next, simulation.cells, changes)) {
+			simulation.applyChanges(next, changes);
+			return;
+		}
+	}
+
+	// the first call records the starting state, after that it is a no-op
+	history.record(simulation);
+	simulation.step();
+	history.record(simulation);
+	recorder.append(simulation);
+}
+
+bool Sugarcube::openArchive(const char* path) {
+	if (!archive.open(path) || !archive.restore(archive.firstGeneration(), simulation)) {
+		archive.close();
+		return false;
+	}
+	history.clear();
+	originRampScale = glm::length(static_cast<vec3>(archive.size)) * 0.5f;
+	requestRedraw();
+	return true;
+}
+
+void Sugarcube::requestRedraw() {
+	redrawFrames = REDRAW_FRAMES;
+}
+
+bool Sugarcube::captureImage(const char* path, ImageFormats format, ivec2 size, bool tiled) {
+	camera->setSize(size.x, size.y);
+	bool saved = true;
+	int renderSize = std::max(size.x, size.y) * std::max(imageExporter.supersample, 1);
+	if (tiled || renderSize > imageExporter.maxCaptureSize()) {
+		// each tile scales and shifts its part of the flipped clip space to
+		// fill the whole viewport, which works for both camera projections
+		saved = imageExporter.saveTiled(path, format, size.x, size.y,
+			[&](float x, float y, float w, float h) {
+			vec2 scale = 1.0f / vec2(w, h);
+			vec2 center = 2.0f * vec2(x, y) + vec2(w, h) - 1.0f;
+			mat4 tile = glm::scale(mat4(1), vec3(scale, 1));
+			tile = glm::translate(tile, vec3(-center, 0));
+			drawScene(true, tile);
+		});
+	}
+	else {
+		imageExporter.beginCapture(size.x, size.y);
+		drawScene(true);
+		imageExporter.saveImage(path, format);
+	}
+	camera->setSize(screen.x - sidebarWidth, screen.y);
+	return saved;
+}
+
+void Sugarcube::startSequence(const std::string& path, const std::string& extension,
+	ImageFormats format, ivec2 size, bool tiled, int first, int last, float orbitDegrees)
+{
+	// frames are named after the chosen file, e.g. run.png becomes
+	// run_00001.png, run_00002.png and so on
+	std::string base = path;
+	std::string suffix = "." + extension;
+	if (base.size() >= suffix.size() &&
+		base.compare(base.size() - suffix.size(), suffix.size(), suffix) == 0)
+		base.erase(base.size() - suffix.size());
+
+	first = std::max(first, simulation.getGeneration());
+	if (last < first) {
+		std::cout << "Can't export, the generation range is empty" << std::endl;
+		return;
+	}
+
+	sequence.active = true;
+	sequence.first = first;
+	sequence.last = last;
+	sequence.base = base;
+	sequence.extension = extension;
+	sequence.format = format;
+	sequence.size = size;
+	sequence.tiled = tiled;
+	sequence.orbitDegrees = orbitDegrees;
+	sequence.startAzimuth = camera->getAzimuth();
+	playing = false;
+}
+
+void Sugarcube::exportSequenceFrame() {
+	// generations before the range are stepped through, one per update
+	if (simulation.getGeneration() < sequence.first) {
+		stepSimulation();
+		return;
+	}
+
+	// wait while the encoders are behind, so the queue of mapped readback
+	// buffers stays bounded
+	if (imageExporter.pendingCount() >= 2 * static_cast<int>(ThreadPool::shared().size())) return;
+
+	int frame = simulation.getGeneration() - sequence.first;
+	char number[16];
+	snprintf(number, sizeof(number), "_%05d.", frame + 1);
+	camera->setAzimuth(sequence.startAzimuth + sequence.orbitDegrees * frame);
+	captureImage((sequence.base + number + sequence.extension).c_str(),
+		sequence.format, sequence.size, sequence.tiled);
+
+	// the next frame renders while this one is read back and encoded
+	if (simulation.getGeneration() >= sequence.last) endSequence();
+	else stepSimulation();
+}
+
+void Sugarcube::endSequence() {
+	sequence.active = false;
+	camera->setAzimuth(sequence.startAzimuth);
+}
+
+void Sugarcube::loadSweepResult(const SweepResult& result) {
+	const SweepSettings& settings = sweep.settings;
+	std::vector<bool> noise = Sweep::startingCells(settings.noiseSize, result.seed);
+	history.clear();
+	recorder.close();
+	archive.close();
+	simulation.resize(settings.size);
+	simulation.eL = result.rule[0];
+	simulation.eU = result.rule[1];
+	simulation.fL = result.rule[2];
+	simulation.fU = result.rule[3];
+	simulation.createFromGrid(GridView(noise, settings.noiseSize));
+	originRampScale = glm::length(static_cast<vec3>(settings.size)) * 0.5f;
+}
+
+void Sugarcube::loadSimulation(const Automata3D& source) {
+	history.clear();
+	recorder.close();
+	archive.close();
+	simulation.eL = source.eL;
+	simulation.eU = source.eU;
+	simulation.fL = source.fL;
+	simulation.fU = source.fU;
+	simulation.setState(source.getSize(), source.getGeneration(), std::vector<bool>(source.cells));
+	originRampScale = glm::length(static_cast<vec3>(source.getSize())) * 0.5f;
+}
+
+bool Sugarcube::renderImage(const char* path, ivec2 size, int supersample) {
+	ImageFormats format;
+	if (!ImageExporter::formatFromPath(path, format)) {
+		std::cout << "Error: unknown image format\n" << path << std::endl;
+		return false;
 	}
+	int previous = imageExporter.supersample;
+	imageExporter.supersample = supersample;
+	bool saved = captureImage(path, format, size, false);
+	imageExporter.supersample = previous;
+	// captures that fit one framebuffer are written on the pool, only
+	// finishing them tells whether they were saved
+	return imageExporter.finish() && saved;
+}
+
+void Sugarcube::shutdown() {
+	imageExporter.finish();
+	recorder.close();
+	// the sweep uses the shared thread pool, which is gone after main
+	sweep.cancel();
+	sweep.finish();
+}
+
+bool Sugarcube::needsRedraw() {
+	return redrawFrames > 0;
+}
+
+bool Sugarcube::isIdle() {
+	return !playing && !needsRedraw();
 }
 
 void Sugarcube::draw() {
+	PROFILE_SCOPE(ProfileStage::Frame);
+	if (redrawFrames > 0) redrawFrames--;
+
 	glClearColor(bgColor.r, bgColor.g, bgColor.b, bgColor.a);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -68,45 +296,43 @@ void Sugarcube::resize(float width, float height) {
 	screen = { width, height };
 }
 
-void Sugarcube::drawScene(bool flipY) {
-	// set ramp shader uniforms
-	if (shader == ShaderType::Ramp) {
-		rampShader.setVec4("nearColor", nearColor);
-		rampShader.setVec4("farColor", farColor);
-		rampShader.setVec4("innerColor", innerColor);
-		rampShader.setVec4("outerColor", outerColor);
-		rampShader.setFloat("cameraRampScale", cameraRampScale);
-		rampShader.setFloat("cameraRampOffset", cameraRampOffset);
-		rampShader.setFloat("originRampScale", originRampScale);
-		rampShader.setFloat("originRampOffset", originRampOffset);
-		rampShader.setFloat("rampMode", static_cast<float>(rampMode));
-		rampShader.setInt("smoothLight", smoothLight);
-	}
-
-	// set normal shader uniforms
-	if (shader == ShaderType::Normal) {
-		normalShader.setVec4("xColor", xColor);
-		normalShader.setVec4("yColor", yColor);
-		normalShader.setVec4("zColor", zColor);
-		normalShader.setVec4("lightColor", lightColor);
-		normalShader.setVec4("ambientColor", ambientColor);
-
-		mat4 lightRotation = glm::rotate(mat4(1), glm::radians(lightAzimuth), vec3(0, 1, 0));
-		lightRotation = glm::rotate(lightRotation, glm::radians(lightAltitude), vec3(1, 0, 0));
-		vec3 lightDir = lightRotation * vec4(0, 0, 1, 1);
-
-		normalShader.setVec3("lightDir", lightDir);
-		normalShader.setFloat("normalMix", normalMix);
-		normalShader.setFloat("lightMix", lightMix);
-	}
-	
-	// set common uniforms
-	rampShader.setMat4("view", camera->getViewMatrix());
-	rampShader.setMat4("projection", camera->getProjectionMatrix(flipY));
-	normalShader.setMat4("view", camera->getViewMatrix());
-	normalShader.setMat4("projection", camera->getProjectionMatrix(flipY));
-
+void Sugarcube::drawScene(bool flipY, const mat4& tile) {
+	PROFILE_SCOPE(ProfileStage::Draw);
+	CameraBlock cameraBlock;
+	cameraBlock.view = camera->getViewMatrix();
+	cameraBlock.projection = tile * camera->getProjectionMatrix(flipY);
+	cameraUniforms.update(&cameraBlock);
+
+	mat4 lightRotation = glm::rotate(mat4(1), glm::radians(lightAzimuth), vec3(0, 1, 0));
+	lightRotation = glm::rotate(lightRotation, glm::radians(lightAltitude), vec3(1, 0, 0));
+
+	// both shaders read from the same block, so it is filled in regardless
+	// of which one is active
+	ShadingBlock shading;
+	shading.nearColor = nearColor;
+	shading.farColor = farColor;
+	shading.innerColor = innerColor;
+	shading.outerColor = outerColor;
+	shading.xColor = xColor;
+	shading.yColor = yColor;
+	shading.zColor = zColor;
+	shading.ambientColor = ambientColor;
+	shading.lightColor = lightColor;
+	shading.lightDir = lightRotation * vec4(0, 0, 1, 1);
+	shading.rampMode = static_cast<float>(rampMode);
+	shading.cameraRampScale = cameraRampScale;
+	shading.cameraRampOffset = cameraRampOffset;
+	shading.originRampScale = originRampScale;
+	shading.originRampOffset = originRampOffset;
+	shading.normalMix = normalMix;
+	shading.lightMix = lightMix;
+	shading.occlusionStrength = occlusionStrength;
+	shading.smoothLight = smoothLight;
+	shadingUniforms.update(&shading);
+
+	PROFILE_GPU_BEGIN();
 	simulation.draw();
+	PROFILE_GPU_END();
 }
 
 static void HelpMarker(const char* desc)
@@ -123,6 +349,8 @@ static void HelpMarker(const char* desc)
 }
 
 void Sugarcube::drawGui() {
+	PROFILE_SCOPE(ProfileStage::Gui);
+
 	// start imgui frame
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
@@ -144,10 +372,42 @@ void Sugarcube::drawGui() {
 			playing = !playing;
 		}
 		ImGui::SameLine();
-		if (ImGui::Button("Step")) simulation.step();
+		if (ImGui::Button("Step")) stepSimulation();
+#if SUGARCUBE_PROFILE
+		ImGui::SameLine();
+		ImGui::Checkbox("Profiler", &showProfiler);
+#endif
+
+		// timeline of an open run archive
+		if (archive.isOpen()) {
+			int shown = simulation.getGeneration();
+			ImGui::Text("Run: %d - %d", archive.firstGeneration(), archive.lastGeneration());
+			if (ImGui::SliderInt("##archive", &shown,
+				archive.firstGeneration(), archive.lastGeneration()))
+			{
+				playing = false;
+				archive.restore(shown, simulation);
+			}
+		}
+
+		// timeline of the recorded generations
+		if (!history.isEmpty() && history.lastGeneration() > history.firstGeneration()) {
+			int shown = simulation.getGeneration();
+			if (ImGui::SliderInt("##timeline", &shown,
+				history.firstGeneration(), history.lastGeneration()))
+			{
+				playing = false;
+				history.seek(shown, simulation);
+			}
+			ImGui::Text("History: %.1f MiB", history.memoryUsed() / (1024.0f * 1024.0f));
+		}
 	}
 	ImGui::End();
 
+#if SUGARCUBE_PROFILE
+	if (showProfiler) Profiler::drawPanel(&showProfiler);
+#endif
+
 	// sidebar
 	ImGui::SetNextWindowPos(ImVec2(screen.x - sidebarWidth, 0), 
 		ImGuiCond_Always, ImVec2(0.0f, 0.0f));
@@ -163,6 +423,7 @@ void Sugarcube::drawGui() {
 			ImGui::RadioButton("Cross", &startShape, 1);
 			ImGui::RadioButton("Corners", &startShape, 2);
 			ImGui::RadioButton("Noise", &startShape, 3);
+			ImGui::RadioButton("Vox file", &startShape, 4);
 
 			ImGui::Text("Shape specific parameters");
 			static ivec3 boxSize = ivec3(2);
@@ -192,6 +453,22 @@ void Sugarcube::drawGui() {
 			else if (startShape == 3) {
 				ImGui::InputInt3("Area size", &noiseAreaSize.x);
 			}
+			else if (startShape == 4) {
+				if (ImGui::Button("Open vox file")) {
+					char* openPath = NULL;
+					nfdresult_t result = NFD_OpenDialog("vox", NULL, &openPath);
+
+					if (result == NFD_OKAY) {
+						if (!VoxFile::read(openPath, importedCells, importedSize)) importedCells.clear();
+					}
+					else if (result != NFD_CANCEL) {
+						std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+					}
+				}
+				if (importedCells.empty()) ImGui::Text("No file loaded");
+				else ImGui::Text("Loaded %i x %i x %i", importedSize.x, importedSize.y, importedSize.z);
+				ImGui::SameLine(); HelpMarker(Tooltip::voxImport.c_str());
+			}
 
 			static int eL = 4;
 			static int eU = 5;
@@ -210,7 +487,17 @@ void Sugarcube::drawGui() {
 			ImGui::SliderInt("fL", &fL, 0, 26);
 			ImGui::SliderInt("fU", &fU, 0, 26);
 
+			static int historyLimit = static_cast<int>(history.memoryCap >> 20);
+			if (ImGui::InputInt("History limit (MiB)", &historyLimit)) {
+				historyLimit = std::max(historyLimit, 1);
+				history.memoryCap = static_cast<size_t>(historyLimit) << 20;
+			}
+			ImGui::SameLine(); HelpMarker(Tooltip::history.c_str());
+
 			if (ImGui::Button("Generate", ImVec2(ImGui::GetContentRegionAvailWidth(), 30))) {
+				history.clear();
+				recorder.close();
+				archive.close();
 				simulation.resize(simulationSize);
 				originRampScale = glm::length(static_cast<vec3>(simulationSize)) * 0.5f;
 				simulation.eL = eL;
@@ -221,6 +508,192 @@ void Sugarcube::drawGui() {
 				if (startShape == 1) simulation.createCross(crossThickness, omitX, omitY, omitZ);
 				if (startShape == 2) simulation.createCorners(cornerThickness);
 				if (startShape == 3) simulation.createNoise(noiseAreaSize);
+				if (startShape == 4) simulation.createFromGrid(GridView(importedCells, importedSize));
+			}
+
+			if (ImGui::Button("Save checkpoint")) {
+				char* savePath = NULL;
+				nfdresult_t result = NFD_SaveDialog("sgc", NULL, &savePath);
+
+				if (result == NFD_OKAY) Checkpoint::save(savePath, simulation);
+				else if (result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Load checkpoint")) {
+				char* openPath = NULL;
+				nfdresult_t result = NFD_OpenDialog("sgc", NULL, &openPath);
+
+				Checkpoint checkpoint;
+				if (result == NFD_OKAY && checkpoint.open(openPath) && checkpoint.restore(simulation)) {
+					history.clear();
+					recorder.close();
+					archive.close();
+					// match the controls to the loaded run
+					simulationSize = checkpoint.size;
+					originRampScale = glm::length(static_cast<vec3>(simulationSize)) * 0.5f;
+					eL = checkpoint.eL;
+					eU = checkpoint.eU;
+					fL = checkpoint.fL;
+					fU = checkpoint.fU;
+				}
+				else if (result != NFD_OKAY && result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
+			}
+			ImGui::SameLine(); HelpMarker(Tooltip::checkpoint.c_str());
+
+			static bool recordingFailed = false;
+			if (!recorder.isOpen()) {
+				// a recording that couldn't be written is wrapped up here, so
+				// the failure shows even while the simulation is paused
+				if (!recorder.close()) recordingFailed = true;
+				if (ImGui::Button("Record run")) {
+					char* savePath = NULL;
+					nfdresult_t result = NFD_SaveDialog("sgr", NULL, &savePath);
+
+					if (result == NFD_OKAY) recordingFailed = !recorder.open(savePath, simulation);
+					else if (result != NFD_CANCEL) {
+						std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+					}
+				}
+				if (recordingFailed) {
+					ImGui::SameLine();
+					ImGui::Text("Recording failed");
+				}
+			}
+			else {
+				if (ImGui::Button("Stop recording")) recordingFailed = !recorder.close();
+				ImGui::SameLine();
+				ImGui::Text("%d generations", recorder.recordedGenerations());
+			}
+			ImGui::SameLine();
+			if (!archive.isOpen()) {
+				if (ImGui::Button("Open run")) {
+					char* openPath = NULL;
+					nfdresult_t result = NFD_OpenDialog("sgr", NULL, &openPath);
+
+					if (result == NFD_OKAY && openArchive(openPath)) {
+						simulationSize = archive.size;
+						eL = archive.eL;
+						eU = archive.eU;
+						fL = archive.fL;
+						fU = archive.fU;
+					}
+					else if (result != NFD_OKAY && result != NFD_CANCEL) {
+						std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+					}
+				}
+			}
+			else if (ImGui::Button("Close run")) {
+				archive.close();
+			}
+			ImGui::SameLine(); HelpMarker(Tooltip::runArchive.c_str());
+
+			ImGui::Separator();
+			if (ImGui::TreeNode("Rule sweep")) {
+				static SweepSettings sweepSettings = Sweep::defaultSettings();
+				static int seeds[2] = { 1, 1 };
+				const char* ruleNames[4] = { "eL range", "eU range", "fL range", "fU range" };
+				for (int i = 0; i < 4; i++) {
+					ImGui::DragIntRange2(ruleNames[i], &sweepSettings.ruleMin[i], &sweepSettings.ruleMax[i], 0.1f, 0, 26);
+				}
+				ImGui::InputInt3("Grid size", &sweepSettings.size.x);
+				ImGui::InputInt3("Noise size", &sweepSettings.noiseSize.x);
+				ImGui::InputInt2("Seeds (first, count)", seeds);
+				ImGui::InputInt("Generations", &sweepSettings.generations);
+				sweepSettings.firstSeed = static_cast<uint32_t>(seeds[0]);
+				sweepSettings.seeds = seeds[1];
+				ImGui::Text("%lld runs", static_cast<long long>(Sweep::runCount(sweepSettings)));
+
+				if (sweep.isRunning()) {
+					ImGui::ProgressBar(sweep.progress());
+					if (ImGui::Button("Cancel sweep")) sweep.cancel();
+				}
+				else {
+					if (ImGui::Button("Run sweep")) {
+						char* savePath = NULL;
+						nfdresult_t result = NFD_SaveDialog("sgs,csv", NULL, &savePath);
+
+						if (result == NFD_OKAY) sweep.start(sweepSettings, savePath);
+						else if (result != NFD_CANCEL) {
+							std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+						}
+					}
+					ImGui::SameLine();
+					if (ImGui::Button("Open results")) {
+						char* openPath = NULL;
+						nfdresult_t result = NFD_OpenDialog("sgs,csv", NULL, &openPath);
+
+						if (result == NFD_OKAY) sweep.load(openPath);
+						else if (result != NFD_CANCEL) {
+							std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+						}
+					}
+					if (sweep.hasFailed()) {
+						ImGui::SameLine();
+						ImGui::Text("Saving results failed");
+					}
+				}
+				ImGui::SameLine(); HelpMarker(Tooltip::sweep.c_str());
+
+				// results matching the outcome filter, only rebuilt when the
+				// filter or the results change
+				static int outcomeFilter = 0;
+				static int shownRevision = -1;
+				static std::vector<int> shownRows;
+				static int selectedRow = -1;
+				if (!sweep.isRunning()) {
+					const char* filters[] = { "All", "Died", "Exploded", "Still life", "Periodic", "Chaotic" };
+					bool filterChanged = ImGui::Combo("Outcome", &outcomeFilter, filters, IM_ARRAYSIZE(filters));
+					if (filterChanged || shownRevision != sweep.revision()) {
+						shownRevision = sweep.revision();
+						shownRows.clear();
+						selectedRow = -1;
+						for (int i = 0; i < static_cast<int>(sweep.results.size()); i++) {
+							if (outcomeFilter == 0 || static_cast<int>(sweep.results[i].outcome) == outcomeFilter - 1)
+								shownRows.push_back(i);
+						}
+					}
+					ImGui::Text("%d of %d runs", static_cast<int>(shownRows.size()), static_cast<int>(sweep.results.size()));
+
+					ImGui::BeginChild("Sweep results", ImVec2(0, 150), true);
+					ImGuiListClipper clipper(static_cast<int>(shownRows.size()));
+					while (clipper.Step()) {
+						for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+							const SweepResult& result = sweep.results[shownRows[row]];
+							char label[96];
+							if (result.outcome == SweepOutcome::Periodic) {
+								snprintf(label, sizeof(label), "%d/%d/%d/%d  seed %u  period %d##%d", result.rule[0], result.rule[1],
+									result.rule[2], result.rule[3], result.seed, result.period, row);
+							}
+							else {
+								snprintf(label, sizeof(label), "%d/%d/%d/%d  seed %u  %s##%d", result.rule[0], result.rule[1],
+									result.rule[2], result.rule[3], result.seed, Sweep::outcomeName(result.outcome), row);
+							}
+							if (ImGui::Selectable(label, selectedRow == row)) {
+								selectedRow = row;
+								loadSweepResult(result);
+								// match the controls to the loaded run
+								simulationSize = sweep.settings.size;
+								startShape = 3;
+								noiseAreaSize = sweep.settings.noiseSize;
+								eL = result.rule[0];
+								eU = result.rule[1];
+								fL = result.rule[2];
+								fU = result.rule[3];
+							}
+							if (ImGui::IsItemHovered()) {
+								ImGui::SetTooltip("%d steps, cycle from step %d\nPopulation %d, peak %d, mean %.1f",
+									result.steps, result.transient, result.population,
+									result.peakPopulation, result.meanPopulation);
+							}
+						}
+					}
+					ImGui::EndChild();
+				}
+				ImGui::TreePop();
 			}
 		}
 
@@ -233,6 +706,10 @@ void Sugarcube::drawGui() {
 				else if (shader == ShaderType::Normal) normalShader.use();
 			}
 			ImGui::SameLine(); HelpMarker(Tooltip::shaders.c_str());
+			ImGui::SliderFloat("Occlusion", &occlusionStrength, 0.0f, 1.0f);
+			ImGui::SameLine(); HelpMarker(Tooltip::occlusion.c_str());
+			ImGui::Checkbox("Merge faces when paused", &mergeWhenPaused);
+			ImGui::SameLine(); HelpMarker(Tooltip::mergeFaces.c_str());
 			ImGui::Separator();
 
 			// ramp shader settings
@@ -301,46 +778,179 @@ void Sugarcube::drawGui() {
 				"png",
 				"bmp",
 				"tga",
-				"jpg"
+				"jpg",
+				"ppm",
+				"pam",
+				"raw"
 			};
-			static const char* currentItem = "png";
+			// in the same order as formats
+			static const ImageFormats formatTypes[] = {
+				ImageFormats::PNG,
+				ImageFormats::BMP,
+				ImageFormats::TGA,
+				ImageFormats::JPEG,
+				ImageFormats::PPM,
+				ImageFormats::PAM,
+				ImageFormats::RAW
+			};
+			static int currentFormat = 0;
+			const char* currentItem = formats[currentFormat];
 
 			if (ImGui::BeginCombo("Image format", currentItem)) {
-				for (int i = 0; i < 4; i++) {
-					bool isSelected = (currentItem == formats[i]);
+				for (int i = 0; i < IM_ARRAYSIZE(formats); i++) {
+					bool isSelected = (currentFormat == i);
 					if (ImGui::Selectable(formats[i], isSelected))
-						currentItem = formats[i];
+						currentFormat = i;
 					if (isSelected)
 						ImGui::SetItemDefaultFocus();
 				}
 				ImGui::EndCombo();
 			}
+			ImGui::SameLine(); HelpMarker(Tooltip::imageFormat.c_str());
 
-			ImageFormats saveFormat;
-			if (currentItem == "png") saveFormat = ImageFormats::PNG;
-			else if (currentItem == "bmp") saveFormat = ImageFormats::BMP;
-			else if (currentItem == "tga") saveFormat = ImageFormats::TGA;
-			else if (currentItem == "jpg") saveFormat = ImageFormats::JPEG;
+			currentItem = formats[currentFormat];
+			ImageFormats saveFormat = formatTypes[currentFormat];
+
+			if (saveFormat == ImageFormats::PNG) {
+				ImGui::SliderInt("PNG compression", &imageExporter.pngCompression, 0, 9);
+				ImGui::SameLine(); HelpMarker(Tooltip::pngCompression.c_str());
+			}
+
+			// large images are split into tiles anyway, this also tiles the
+			// smaller ones to keep video memory use down
+			static bool renderTiles = false;
+			ImGui::Checkbox("Render in tiles", &renderTiles);
+			ImGui::SameLine(); HelpMarker(Tooltip::tiledExport.c_str());
+
+			static int msaa = 0;
+			if (ImGui::Combo("MSAA", &msaa, "Off\0" "2x\0" "4x\0" "8x\0"))
+				imageExporter.samples = 1 << msaa;
+			ImGui::SameLine(); HelpMarker(Tooltip::antiAliasing.c_str());
+			ImGui::SliderInt("Supersampling", &imageExporter.supersample, 1, 4, "%dx");
 
 			if (ImGui::Button("Export image")) {
 				char* savePath = NULL;
 				nfdresult_t result = NFD_SaveDialog("", NULL, &savePath);
 
 				if (result == NFD_OKAY) {
-					imageExporter.beginCapture(imageSize.x, imageSize.y);
-					camera->setSize(imageSize.x, imageSize.y);
-					drawScene(true);
-					imageExporter.saveImage(savePath, saveFormat);
-					camera->setSize(screen.x - sidebarWidth, screen.y);
+					captureImage(savePath, saveFormat, imageSize, renderTiles);
 				}
 				else if (result != NFD_CANCEL) {
 					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
 				}
 			}
+
+			// numbered frames of a range of generations
+			static int frameRange[2] = { 1, 100 };
+			static bool orbitCamera = false;
+			static float orbitDegrees = 1.0f;
+			ImGui::InputInt2("Frames", frameRange);
+			ImGui::Checkbox("Orbit camera", &orbitCamera);
+			if (orbitCamera) ImGui::SliderFloat("Degrees per frame", &orbitDegrees, -10.0f, 10.0f);
+			if (sequence.active) {
+				float done = static_cast<float>(std::max(simulation.getGeneration() - sequence.first, 0));
+				ImGui::ProgressBar(done / static_cast<float>(sequence.last - sequence.first + 1));
+				ImGui::SameLine();
+				if (ImGui::Button("Cancel")) endSequence();
+			}
+			else if (ImGui::Button("Export frames")) {
+				char* savePath = NULL;
+				nfdresult_t result = NFD_SaveDialog(currentItem, NULL, &savePath);
+
+				if (result == NFD_OKAY) {
+					startSequence(savePath, currentItem, saveFormat, imageSize, renderTiles,
+						frameRange[0], frameRange[1], orbitCamera ? orbitDegrees : 0.0f);
+				}
+				else if (result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
+			}
+			ImGui::SameLine(); HelpMarker(Tooltip::exportFrames.c_str());
+			if (imageExporter.pendingCount() > 0) {
+				ImGui::ProgressBar(imageExporter.progress(), ImVec2(-1.0f, 0.0f));
+				ImGui::Text("Saving %d image(s)", imageExporter.pendingCount());
+			}
+			static bool mergeMeshFaces = false;
 			if (ImGui::Button("Export OBJ")) {
-				objExporter.load(simulation.cells, simulation.getSize());
-				objExporter.exportObj();
+				objExporter.load(simulation.getGrid());
+				objExporter.exportObj(mergeMeshFaces);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Export PLY")) {
+				char* savePath = NULL;
+				nfdresult_t result = NFD_SaveDialog("ply", NULL, &savePath);
+
+				if (result == NFD_OKAY) {
+					meshExporter.load(simulation.getGrid());
+					meshExporter.exportPly(savePath, mergeMeshFaces);
+				}
+				else if (result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Export STL")) {
+				char* savePath = NULL;
+				nfdresult_t result = NFD_SaveDialog("stl", NULL, &savePath);
+
+				if (result == NFD_OKAY) {
+					meshExporter.load(simulation.getGrid());
+					meshExporter.exportStl(savePath, mergeMeshFaces);
+				}
+				else if (result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Export VOX")) {
+				char* savePath = NULL;
+				nfdresult_t result = NFD_SaveDialog("vox", NULL, &savePath);
+
+				if (result == NFD_OKAY) exportVox(savePath);
+				else if (result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
 			}
+			ImGui::SameLine();
+			if (ImGui::Button("Export glTF")) {
+				char* savePath = NULL;
+				nfdresult_t result = NFD_SaveDialog("glb", NULL, &savePath);
+
+				// merged faces trade the instancing extension for a plain mesh
+				if (result == NFD_OKAY) {
+					if (mergeMeshFaces) gltfExporter.exportMerged(savePath, simulation.getGrid());
+					else gltfExporter.exportInstanced(savePath, simulation.blocks);
+				}
+				else if (result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
+			}
+			ImGui::Checkbox("Merge faces", &mergeMeshFaces);
+
+			static int animationRange[2] = { 1, 100 };
+			ImGui::InputInt2("Generations", animationRange);
+			if (animationExporter.isRunning()) {
+				// keep drawing so the progress bar moves while the simulation
+				// is stepped in the background
+				ImGui::ProgressBar(animationExporter.progress());
+				requestRedraw();
+			}
+			else if (ImGui::Button("Export animation")) {
+				char* savePath = NULL;
+				nfdresult_t result = NFD_SaveDialog("glb", NULL, &savePath);
+
+				if (result == NFD_OKAY) {
+					animationExporter.start(simulation, animationRange[0], animationRange[1], savePath);
+				}
+				else if (result != NFD_CANCEL) {
+					std::cout << "Error (nfd): " << NFD_GetError() << std::endl;
+				}
+			}
+			if (!animationExporter.isRunning() && animationExporter.hasFailed()) {
+				ImGui::SameLine();
+				ImGui::Text("Export failed");
+			}
+			ImGui::SameLine(); HelpMarker(Tooltip::exportAnimation.c_str());
 		}
 	}
 	ImGui::End();
@@ -348,4 +958,29 @@ void Sugarcube::drawGui() {
 	// end imgui frame
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
+
+void Sugarcube::exportVox(const char* path) {
+	// the palette is the origin distance ramp, each voxel gets the index of
+	// the ramp color at its distance like the ramp shader would give it
+	std::vector<u8vec4> palette(256);
+	for (int i = 0; i < 255; i++) {
+		vec4 color = glm::mix(innerColor, outerColor, static_cast<float>(i) / 254.0f);
+		palette[i] = u8vec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	GridView grid = simulation.getGrid();
+	std::vector<uint8_t> colorIndices(grid.cells->size(), 1);
+	vec3 center = vec3(grid.size - 1) * 0.5f;
+	for (int z = 0; z < grid.size.z; z++) {
+		for (int y = 0; y < grid.size.y; y++) {
+			for (int x = 0; x < grid.size.x; x++) {
+				float t = glm::length(vec3(x, y, z) - center) / originRampScale + originRampOffset;
+				colorIndices[grid.coordsToIndex(x, y, z)] =
+					static_cast<uint8_t>(1 + glm::clamp(t, 0.0f, 1.0f) * 254.0f + 0.5f);
+			}
+		}
+	}
+
+	VoxFile::write(path, grid, &colorIndices, &palette);
 }
\ No newline at end of file
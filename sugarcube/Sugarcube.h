@@ -1,19 +1,30 @@
 #pragma once
-#include <imgui\imgui.h>
-#include <imgui\imgui_impl_glfw.h>
-#include <imgui\imgui_impl_opengl3.h>
+#include <imgui/imgui.h>
+#include <imgui/imgui_impl_glfw.h>
+#include <imgui/imgui_impl_opengl3.h>
 
-#include <glad\glad.h>
-#include <GLFW\glfw3.h>
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string>
 
 #include "Shader.h"
+#include "UniformBuffer.h"
 #include "Camera.h"
 #include "Automata3D.h"
 #include "ObjExporter.h"
-#include "PPM_Exporter.h"
+#include "BinaryMeshExporter.h"
+#include "GltfExporter.h"
+#include "AnimationExporter.h"
+#include "VoxFile.h"
+#include "Checkpoint.h"
+#include "History.h"
+#include "RunArchive.h"
 #include "ImageExporter.h"
+#include "Sweep.h"
+#include "Profiler.h"
 
 using vec2 = glm::vec2;
 using ivec2 = glm::ivec2;
@@ -27,6 +38,35 @@ enum class ShaderType {
 	Normal
 };
 
+// std140 layouts of the uniform blocks shared by both shader programs,
+// these must match the declarations in the shaders/ folder
+struct CameraBlock {
+	mat4 view;
+	mat4 projection;
+};
+
+struct ShadingBlock {
+	vec4 nearColor;
+	vec4 farColor;
+	vec4 innerColor;
+	vec4 outerColor;
+	vec4 xColor;
+	vec4 yColor;
+	vec4 zColor;
+	vec4 ambientColor;
+	vec4 lightColor;
+	vec3 lightDir;
+	float rampMode;
+	float cameraRampScale;
+	float cameraRampOffset;
+	float originRampScale;
+	float originRampOffset;
+	float normalMix;
+	float lightMix;
+	float occlusionStrength;
+	int smoothLight;
+};
+
 class Sugarcube {
 
 public:
@@ -36,11 +76,39 @@ public:
 	void draw();
 	void resize(float width, float height);
 
+	void requestRedraw();
+	bool needsRedraw();
+	bool isIdle();
+	// waits for background work that has to finish before exiting
+	void shutdown();
+	// opens a run archive for playback, starting at its first generation
+	bool openArchive(const char* path);
+	// replaces the simulation with a copy of the given one, for rendering
+	// a state that was computed elsewhere
+	void loadSimulation(const Automata3D& source);
+	// renders the current view to an image and waits until it is written,
+	// the format comes from the file extension
+	bool renderImage(const char* path, ivec2 size, int supersample = 1);
+
 	Camera* camera;
 
 private:
-	void drawScene(bool flipY = false);
+	// tile is applied after the projection, tiled image exports use it to
+	// narrow the view down to one tile
+	void drawScene(bool flipY = false, const mat4& tile = mat4(1));
 	void drawGui();
+	void exportVox(const char* path);
+	void stepSimulation();
+	// images larger than a framebuffer are always rendered in tiles. Tiled
+	// images are written before it returns, false if that failed, others
+	// are only started and report through imageExporter.finish()
+	bool captureImage(const char* path, ImageFormats format, ivec2 size, bool tiled);
+	void startSequence(const std::string& path, const std::string& extension,
+		ImageFormats format, ivec2 size, bool tiled, int first, int last, float orbitDegrees);
+	void exportSequenceFrame();
+	void endSequence();
+	// replaces the simulation with the starting state and rule of a sweep run
+	void loadSweepResult(const SweepResult& result);
 
 	vec2 screen;
 	float sidebarWidth;
@@ -48,10 +116,15 @@ private:
 	float elapsed;
 	float playSpeed;
 	bool playing;
+	int redrawFrames;
+	bool showProfiler;
+	bool mergeWhenPaused;
 
 	ShaderType shader;
 	Shader rampShader;
 	Shader normalShader;
+	UniformBuffer cameraUniforms;
+	UniformBuffer shadingUniforms;
 
 	vec4 bgColor;
 
@@ -65,6 +138,7 @@ private:
 	float originRampOffset;
 	float cameraRampScale;
 	float cameraRampOffset;
+	float occlusionStrength;
 
 	vec4 xColor;
 	vec4 yColor;
@@ -76,7 +150,30 @@ private:
 	float normalMix;
 	float lightMix;
 
+	// image sequence export in progress, one frame is captured per update
+	struct SequenceExport {
+		bool active;
+		int first, last;
+		std::string base;
+		std::string extension;
+		ImageFormats format;
+		ivec2 size;
+		bool tiled;
+		float orbitDegrees;
+		float startAzimuth;
+	} sequence;
+
 	Automata3D simulation;
+	History history;
+	ArchiveWriter recorder;
+	ArchiveReader archive;
+	// grid read from a vox file, used as the starting shape
+	std::vector<bool> importedCells;
+	ivec3 importedSize;
 	ObjExporter objExporter;
+	BinaryMeshExporter meshExporter;
+	GltfExporter gltfExporter;
+	AnimationExporter animationExporter;
 	ImageExporter imageExporter;
+	Sweep sweep;
 };
\ No newline at end of file
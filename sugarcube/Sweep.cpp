@@ -0,0 +1,506 @@
+#include "Sweep.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+static const char MAGIC[4] = { 'S', 'G', 'S', 'W' };
+static const uint32_t VERSION = 1;
+// runs handed to the pool at once, cancelling waits for the batch to end
+static const int RUNS_PER_THREAD = 64;
+
+static const char* CSV_HEADER =
+	"eL,eU,fL,fU,seed,outcome,period,transient,steps,population,peak_population,mean_population,hash,"
+	"size_x,size_y,size_z,noise_x,noise_y,noise_z,generations";
+
+struct SweepHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t size[3];
+	int32_t noiseSize[3];
+	int32_t generations;
+	float explodeFraction;
+	int32_t ruleMin[4];
+	int32_t ruleMax[4];
+	int32_t seeds;
+	uint32_t firstSeed;
+	uint64_t count;
+};
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+	if (text.size() < suffix.size()) return false;
+	std::string end = text.substr(text.size() - suffix.size());
+	std::transform(end.begin(), end.end(), end.begin(), ::tolower);
+	return end == suffix;
+}
+
+// null when a sweep can run with the settings, they come from the gui or
+// a results file so nothing about them is trusted
+static const char* settingsError(const SweepSettings& settings) {
+	if (glm::any(glm::lessThan(settings.size, ivec3(1))) ||
+		glm::any(glm::lessThan(settings.noiseSize, ivec3(1))) ||
+		glm::any(glm::greaterThan(settings.noiseSize, settings.size)))
+	{
+		return "the noise size must fit in the grid size";
+	}
+	if (static_cast<int64_t>(settings.size.x) * settings.size.y * settings.size.z > INT_MAX) {
+		return "the grid size is too large";
+	}
+	for (int i = 0; i < 4; i++) {
+		if (settings.ruleMin[i] < 0 || settings.ruleMax[i] > 26 || settings.ruleMin[i] > settings.ruleMax[i]) {
+			return "rule ranges must be within 0 to 26";
+		}
+	}
+	if (settings.generations < 1 || settings.seeds < 1) {
+		return "generations and seeds must be positive";
+	}
+	return nullptr;
+}
+
+// the rule and seed of run index, seeds vary fastest and eL slowest
+static void decodeRun(const SweepSettings& settings, int64_t index, int rule[4], uint32_t& seed) {
+	seed = settings.firstSeed + static_cast<uint32_t>(index % settings.seeds);
+	index /= settings.seeds;
+	for (int i = 3; i >= 0; i--) {
+		int range = settings.ruleMax[i] - settings.ruleMin[i] + 1;
+		rule[i] = settings.ruleMin[i] + static_cast<int>(index % range);
+		index /= range;
+	}
+}
+
+// one generation of the same rule as Automata3D::step on a grid padded
+// with a layer of dead cells, so no neighbor lookup needs a bounds check.
+// The 3x3x3 sums are built one axis at a time, which takes 6 additions a
+// cell instead of 26 lookups. Returns the new population
+static int stepCells(const std::vector<uint8_t>& cells, std::vector<uint8_t>& next,
+	std::vector<uint8_t>& sumX, std::vector<uint8_t>& sumY, ivec3 size, const int rule[4])
+{
+	int px = size.x + 2, py = size.y + 2, pz = size.z + 2;
+	int rowStep = px, sliceStep = px * py;
+
+	for (int z = 0; z < pz; z++) {
+		for (int y = 0; y < py; y++) {
+			int row = z * sliceStep + y * rowStep;
+			for (int x = 1; x <= size.x; x++)
+				sumX[row + x] = cells[row + x - 1] + cells[row + x] + cells[row + x + 1];
+		}
+	}
+	for (int z = 0; z < pz; z++) {
+		for (int y = 1; y <= size.y; y++) {
+			int row = z * sliceStep + y * rowStep;
+			for (int x = 1; x <= size.x; x++)
+				sumY[row + x] = sumX[row + x - rowStep] + sumX[row + x] + sumX[row + x + rowStep];
+		}
+	}
+
+	int population = 0;
+	for (int z = 1; z <= size.z; z++) {
+		for (int y = 1; y <= size.y; y++) {
+			int row = z * sliceStep + y * rowStep;
+			for (int x = 1; x <= size.x; x++) {
+				int i = row + x;
+				int neighbors = sumY[i - sliceStep] + sumY[i] + sumY[i + sliceStep] - cells[i];
+				bool alive = cells[i] ?
+					neighbors >= rule[0] && neighbors <= rule[1] :
+					neighbors >= rule[2] && neighbors <= rule[3];
+				next[i] = alive;
+				population += alive;
+			}
+		}
+	}
+	return population;
+}
+
+// 64 bit fnv-1a of the whole padded grid, the padding is always dead
+static uint64_t hashCells(const std::vector<uint8_t>& cells) {
+	uint64_t hash = 14695981039346656037ull;
+	for (uint8_t cell : cells) {
+		hash ^= cell;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+Sweep::Sweep() :
+	settings(defaultSettings()),
+	running(false),
+	cancelled(false),
+	saveFailed(false),
+	runsDone(0),
+	runsTotal(1),
+	resultsRevision(0)
+{}
+
+Sweep::~Sweep() {
+	cancel();
+	finish();
+}
+
+SweepSettings Sweep::defaultSettings() {
+	SweepSettings defaults;
+	defaults.size = ivec3(16);
+	defaults.noiseSize = ivec3(8);
+	defaults.generations = 200;
+	defaults.explodeFraction = 0.5f;
+	for (int i = 0; i < 4; i++) {
+		defaults.ruleMin[i] = 0;
+		defaults.ruleMax[i] = 26;
+	}
+	defaults.seeds = 1;
+	defaults.firstSeed = 1;
+	return defaults;
+}
+
+int64_t Sweep::runCount(const SweepSettings& settings) {
+	int64_t count = std::max(settings.seeds, 0);
+	for (int i = 0; i < 4; i++) count *= std::max(settings.ruleMax[i] - settings.ruleMin[i] + 1, 0);
+	return count;
+}
+
+bool Sweep::start(const SweepSettings& settings, const std::string& path) {
+	if (running) {
+		std::cout << "A sweep is already running" << std::endl;
+		return false;
+	}
+	if (worker.joinable()) worker.join();
+
+	if (const char* error = settingsError(settings)) {
+		std::cout << "Can't sweep, " << error << std::endl;
+		return false;
+	}
+
+	cancelled = false;
+	saveFailed = false;
+	runsDone = 0;
+	runsTotal = runCount(settings);
+	running = true;
+	worker = std::thread(&Sweep::run, this, settings, path);
+	return true;
+}
+
+void Sweep::cancel() {
+	cancelled = true;
+}
+
+void Sweep::finish() {
+	if (worker.joinable()) worker.join();
+}
+
+bool Sweep::isRunning() {
+	return running;
+}
+
+float Sweep::progress() {
+	return static_cast<float>(runsDone) / static_cast<float>(runsTotal);
+}
+
+bool Sweep::hasFailed() {
+	return saveFailed;
+}
+
+int Sweep::revision() {
+	return resultsRevision;
+}
+
+void Sweep::run(SweepSettings settings, std::string path) {
+	TRACE_THREAD_NAME("sweep");
+	TRACE_SCOPE("sweep");
+
+	// whole batches finish before cancelling is checked, so the results
+	// are always the first runs in order
+	int64_t total = runsTotal;
+	std::vector<SweepResult> swept(static_cast<size_t>(total));
+	ThreadPool& pool = ThreadPool::shared();
+	int batch = RUNS_PER_THREAD * static_cast<int>(pool.size());
+	int64_t first = 0;
+	for (; first < total && !cancelled; first += batch) {
+		int count = static_cast<int>(std::min<int64_t>(batch, total - first));
+		pool.parallelFor(0, count, [&](int i) {
+			int rule[4];
+			uint32_t seed;
+			decodeRun(settings, first + i, rule, seed);
+			swept[first + i] = runOne(settings, rule, seed);
+			runsDone++;
+		});
+	}
+	swept.resize(static_cast<size_t>(std::min(first, total)));
+
+	saveFailed = !save(path.c_str(), settings, swept);
+	this->settings = settings;
+	results = std::move(swept);
+	resultsRevision++;
+	running = false;
+}
+
+SweepResult Sweep::runOne(const SweepSettings& settings, const int rule[4], uint32_t seed) {
+	SweepResult result = {};
+	std::copy(rule, rule + 4, result.rule);
+	result.seed = seed;
+
+	ivec3 size = settings.size;
+	ivec3 padded = size + 2;
+	size_t paddedCells = static_cast<size_t>(padded.x) * padded.y * padded.z;
+	std::vector<uint8_t> cells(paddedCells, 0), next(paddedCells, 0);
+	std::vector<uint8_t> sumX(paddedCells, 0), sumY(paddedCells, 0);
+
+	// centered the same way as Automata3D::createFromGrid
+	ivec3 noiseSize = settings.noiseSize;
+	ivec3 offset = (size - noiseSize) / 2 + 1;
+	std::vector<bool> noise = startingCells(noiseSize, seed);
+	int population = 0;
+	for (int z = 0; z < noiseSize.z; z++) {
+		for (int y = 0; y < noiseSize.y; y++) {
+			for (int x = 0; x < noiseSize.x; x++) {
+				bool alive = noise[z * noiseSize.x * noiseSize.y + y * noiseSize.x + x];
+				cells[((z + offset.z) * padded.y + y + offset.y) * padded.x + x + offset.x] = alive;
+				population += alive;
+			}
+		}
+	}
+
+	int64_t explodeLimit = static_cast<int64_t>(settings.explodeFraction * size.x * size.y * size.z);
+	double populationSum = population;
+	result.peakPopulation = population;
+	result.outcome = SweepOutcome::Chaotic;
+
+	// generation each state was first seen at, a repeat closes a cycle
+	std::unordered_map<uint64_t, int> seen;
+	seen.reserve(settings.generations + 1);
+	uint64_t hash = hashCells(cells);
+	seen.emplace(hash, 0);
+
+	int steps = 0;
+	if (population == 0) result.outcome = SweepOutcome::Died;
+	while (population > 0 && steps < settings.generations) {
+		population = stepCells(cells, next, sumX, sumY, size, rule);
+		cells.swap(next);
+		steps++;
+		populationSum += population;
+		result.peakPopulation = std::max(result.peakPopulation, population);
+		hash = hashCells(cells);
+
+		if (population == 0) {
+			result.outcome = SweepOutcome::Died;
+			break;
+		}
+		if (population > explodeLimit) {
+			result.outcome = SweepOutcome::Exploded;
+			break;
+		}
+		auto found = seen.find(hash);
+		if (found != seen.end()) {
+			result.period = steps - found->second;
+			result.transient = found->second;
+			result.outcome = result.period == 1 ? SweepOutcome::StillLife : SweepOutcome::Periodic;
+			break;
+		}
+		seen.emplace(hash, steps);
+	}
+
+	result.steps = steps;
+	result.population = population;
+	result.meanPopulation = static_cast<float>(populationSum / (steps + 1));
+	result.hash = hash;
+	return result;
+}
+
+std::vector<bool> Sweep::startingCells(ivec3 noiseSize, uint32_t seed) {
+	// bits straight from the engine, the std distributions may differ
+	// between standard libraries
+	std::mt19937 random(seed);
+	std::vector<bool> cells(static_cast<size_t>(noiseSize.x) * noiseSize.y * noiseSize.z);
+	for (size_t i = 0; i < cells.size(); i++) cells[i] = (random() >> 31) != 0;
+	return cells;
+}
+
+const char* Sweep::outcomeName(SweepOutcome outcome) {
+	switch (outcome) {
+	case SweepOutcome::Died: return "died";
+	case SweepOutcome::Exploded: return "exploded";
+	case SweepOutcome::StillLife: return "still life";
+	case SweepOutcome::Periodic: return "periodic";
+	default: return "chaotic";
+	}
+}
+
+bool Sweep::save(const char* path, const SweepSettings& settings, const std::vector<SweepResult>& results) {
+	TRACE_SCOPE("saveSweep");
+	if (endsWith(path, ".csv")) return saveCsv(path, settings, results);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+	SweepHeader header = {
+		{ MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3] }, VERSION,
+		{ settings.size.x, settings.size.y, settings.size.z },
+		{ settings.noiseSize.x, settings.noiseSize.y, settings.noiseSize.z },
+		settings.generations, settings.explodeFraction,
+		{ settings.ruleMin[0], settings.ruleMin[1], settings.ruleMin[2], settings.ruleMin[3] },
+		{ settings.ruleMax[0], settings.ruleMax[1], settings.ruleMax[2], settings.ruleMax[3] },
+		settings.seeds, settings.firstSeed, results.size()
+	};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(results.data()), results.size() * sizeof(SweepResult));
+	if (file.fail()) {
+		std::cout << "Error: could not write the sweep results" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Sweep::saveCsv(const char* path, const SweepSettings& settings, const std::vector<SweepResult>& results) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+	file << CSV_HEADER << "\n";
+	char line[256];
+	for (const SweepResult& result : results) {
+		snprintf(line, sizeof(line), "%d,%d,%d,%d,%u,%s,%d,%d,%d,%d,%d,%.2f,%016llx,%d,%d,%d,%d,%d,%d,%d\n",
+			result.rule[0], result.rule[1], result.rule[2], result.rule[3], result.seed,
+			outcomeName(result.outcome), result.period, result.transient, result.steps,
+			result.population, result.peakPopulation, result.meanPopulation,
+			static_cast<unsigned long long>(result.hash),
+			settings.size.x, settings.size.y, settings.size.z,
+			settings.noiseSize.x, settings.noiseSize.y, settings.noiseSize.z, settings.generations);
+		file << line;
+	}
+	if (file.fail()) {
+		std::cout << "Error: could not write the sweep results" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Sweep::load(const char* path) {
+	if (running) {
+		std::cout << "Can't load results while a sweep is running" << std::endl;
+		return false;
+	}
+	if (endsWith(path, ".csv")) return loadCsv(path);
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		std::cout << "Error: could not open file\n" << path << std::endl;
+		return false;
+	}
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	SweepHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || !std::equal(MAGIC, MAGIC + 4, header.magic) || header.version != VERSION) {
+		std::cout << "Error: not a sweep results file\n" << path << std::endl;
+		return false;
+	}
+	if (header.count > (fileSize - sizeof(header)) / sizeof(SweepResult)) {
+		std::cout << "Error: the sweep results file is truncated" << std::endl;
+		return false;
+	}
+
+	std::vector<SweepResult> loaded(static_cast<size_t>(header.count));
+	file.read(reinterpret_cast<char*>(loaded.data()), loaded.size() * sizeof(SweepResult));
+	if (!file) {
+		std::cout << "Error: could not read the sweep results" << std::endl;
+		return false;
+	}
+
+	SweepSettings loadedSettings;
+	loadedSettings.size = ivec3(header.size[0], header.size[1], header.size[2]);
+	loadedSettings.noiseSize = ivec3(header.noiseSize[0], header.noiseSize[1], header.noiseSize[2]);
+	loadedSettings.generations = header.generations;
+	loadedSettings.explodeFraction = header.explodeFraction;
+	std::copy(header.ruleMin, header.ruleMin + 4, loadedSettings.ruleMin);
+	std::copy(header.ruleMax, header.ruleMax + 4, loadedSettings.ruleMax);
+	loadedSettings.seeds = header.seeds;
+	loadedSettings.firstSeed = header.firstSeed;
+	if (const char* error = settingsError(loadedSettings)) {
+		std::cout << "Error: the sweep results file has invalid settings, " << error << std::endl;
+		return false;
+	}
+
+	settings = loadedSettings;
+	results = std::move(loaded);
+	saveFailed = false;
+	resultsRevision++;
+	return true;
+}
+
+bool Sweep::loadCsv(const char* path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cout << "Error: could not open file\n" << path << std::endl;
+		return false;
+	}
+	std::string line;
+	if (!std::getline(file, line) || line != CSV_HEADER) {
+		std::cout << "Error: not a sweep results file\n" << path << std::endl;
+		return false;
+	}
+
+	// every row repeats the grid settings, the ranges come from the rows
+	SweepSettings loadedSettings = defaultSettings();
+	std::vector<SweepResult> loaded;
+	while (std::getline(file, line)) {
+		if (line.empty()) continue;
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, ',')) fields.push_back(field);
+
+		SweepResult result = {};
+		try {
+			if (fields.size() != 20) throw std::invalid_argument("column count");
+			for (int i = 0; i < 4; i++) result.rule[i] = std::stoi(fields[i]);
+			result.seed = static_cast<uint32_t>(std::stoul(fields[4]));
+			int outcome = 0;
+			while (outcome <= static_cast<int>(SweepOutcome::Chaotic) &&
+				fields[5] != outcomeName(static_cast<SweepOutcome>(outcome))) outcome++;
+			if (outcome > static_cast<int>(SweepOutcome::Chaotic)) throw std::invalid_argument("outcome");
+			result.outcome = static_cast<SweepOutcome>(outcome);
+			result.period = std::stoi(fields[6]);
+			result.transient = std::stoi(fields[7]);
+			result.steps = std::stoi(fields[8]);
+			result.population = std::stoi(fields[9]);
+			result.peakPopulation = std::stoi(fields[10]);
+			result.meanPopulation = std::stof(fields[11]);
+			result.hash = std::stoull(fields[12], nullptr, 16);
+			loadedSettings.size = ivec3(std::stoi(fields[13]), std::stoi(fields[14]), std::stoi(fields[15]));
+			loadedSettings.noiseSize = ivec3(std::stoi(fields[16]), std::stoi(fields[17]), std::stoi(fields[18]));
+			loadedSettings.generations = std::stoi(fields[19]);
+		}
+		catch (...) {
+			std::cout << "Error: could not read sweep results row " << loaded.size() + 1 << std::endl;
+			return false;
+		}
+		// the ranges are the defaults until the first row replaces them
+		bool first = loaded.empty();
+		for (int i = 0; i < 4; i++) {
+			loadedSettings.ruleMin[i] = first ? result.rule[i] : std::min(loadedSettings.ruleMin[i], result.rule[i]);
+			loadedSettings.ruleMax[i] = first ? result.rule[i] : std::max(loadedSettings.ruleMax[i], result.rule[i]);
+		}
+		loaded.push_back(result);
+	}
+	if (const char* error = settingsError(loadedSettings)) {
+		std::cout << "Error: the sweep results file has invalid settings, " << error << std::endl;
+		return false;
+	}
+
+	settings = loadedSettings;
+	results = std::move(loaded);
+	saveFailed = false;
+	resultsRevision++;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ivec3 = glm::ivec3;
+
+enum class SweepOutcome : uint32_t {
+	Died,
+	// grew past the explode fraction of the grid, so the walls of the
+	// grid shape what it does from then on
+	Exploded,
+	StillLife,
+	Periodic,
+	// no state repeated before the last generation
+	Chaotic
+};
+
+struct SweepSettings {
+	ivec3 size;
+	// every run starts from random cells filling a box of this size in the
+	// center of the grid
+	ivec3 noiseSize;
+	int generations;
+	float explodeFraction;
+	// inclusive ranges of eL, eU, fL and fU
+	int ruleMin[4];
+	int ruleMax[4];
+	int seeds;
+	uint32_t firstSeed;
+};
+
+struct SweepResult {
+	int32_t rule[4];
+	uint32_t seed;
+	SweepOutcome outcome;
+	// length of the cycle, 1 for still lifes and 0 when there is none
+	int32_t period;
+	// steps before the cycle was first entered
+	int32_t transient;
+	// steps taken before the run was classified
+	int32_t steps;
+	int32_t population;
+	int32_t peakPopulation;
+	float meanPopulation;
+	// hash of the final state, equal hashes are the same structure
+	uint64_t hash;
+};
+
+// runs every combination of rule and seed in the given ranges, each in its
+// own small grid, and classifies how it ends from the population and a
+// hash of every generation. A repeated hash means the run entered a cycle.
+// Runs are spread over the thread pool in batches from a background
+// thread, so a sweep can be followed and cancelled from the gui
+class Sweep {
+
+public:
+	Sweep();
+	~Sweep();
+
+	// results are written to path when the sweep finishes, as csv when the
+	// extension is .csv and in the binary sweep format otherwise
+	bool start(const SweepSettings& settings, const std::string& path);
+	// a cancelled sweep stops after the current batch and still saves the
+	// runs it finished
+	void cancel();
+	// waits for the sweep to end
+	void finish();
+	bool isRunning();
+	float progress();
+	// true when the last sweep couldn't write its results file, the
+	// results are still kept in results
+	bool hasFailed();
+
+	// reads results saved by a sweep, either format
+	bool load(const char* path);
+	// changes whenever results are replaced, so views of them know to update
+	int revision();
+
+	// settings and results of the last finished or loaded sweep, only read
+	// them while no sweep is running
+	SweepSettings settings;
+	std::vector<SweepResult> results;
+
+	static SweepSettings defaultSettings();
+	static int64_t runCount(const SweepSettings& settings);
+	static SweepResult runOne(const SweepSettings& settings, const int rule[4], uint32_t seed);
+	// the random cells a run with this seed starts from, the same on
+	// every platform
+	static std::vector<bool> startingCells(ivec3 noiseSize, uint32_t seed);
+	static bool save(const char* path, const SweepSettings& settings, const std::vector<SweepResult>& results);
+	static const char* outcomeName(SweepOutcome outcome);
+
+private:
+	void run(SweepSettings settings, std::string path);
+	static bool saveCsv(const char* path, const SweepSettings& settings, const std::vector<SweepResult>& results);
+	bool loadCsv(const char* path);
+
+	std::thread worker;
+	std::atomic<bool> running;
+	std::atomic<bool> cancelled;
+	std::atomic<bool> saveFailed;
+	std::atomic<int64_t> runsDone;
+	std::atomic<int64_t> runsTotal;
+	std::atomic<int> resultsRevision;
+};
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "TextWriter.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+// longest token written in one go, a 64 bit integer plus sign and decimals
+static const size_t MAX_TOKEN = 48;
+
+TextWriter::TextWriter(size_t bufferSize) :
+	buffer(bufferSize < MAX_TOKEN ? MAX_TOKEN : bufferSize),
+	used(0)
+{
+	setFloatMode(FloatMode::Shortest);
+}
+
+TextWriter::~TextWriter() {
+	close();
+}
+
+bool TextWriter::open(const char* path) {
+	file.open(path, std::ios::binary);
+	used = 0;
+	return file.is_open();
+}
+
+bool TextWriter::close() {
+	if (!file.is_open()) return false;
+	flush();
+	file.close();
+	return !file.fail();
+}
+
+void TextWriter::setFloatMode(FloatMode mode, int decimals) {
+	floatMode = mode;
+	this->decimals = decimals < 0 ? 0 : (decimals > 9 ? 9 : decimals);
+	scale = 1;
+	for (int i = 0; i < this->decimals; i++) scale *= 10;
+}
+
+void TextWriter::write(char c) {
+	reserve(1);
+	buffer[used++] = c;
+}
+
+void TextWriter::write(const char* str) {
+	size_t length = std::strlen(str);
+	if (length > buffer.size()) {
+		flush();
+		file.write(str, length);
+		return;
+	}
+	reserve(length);
+	std::memcpy(&buffer[used], str, length);
+	used += length;
+}
+
+void TextWriter::writeInt(long long value) {
+	reserve(MAX_TOKEN);
+	char* end = std::to_chars(&buffer[used], &buffer[used] + MAX_TOKEN, value).ptr;
+	used = end - &buffer[0];
+}
+
+void TextWriter::writeFloat(float value) {
+	// fixed point formatting with integer math, the value is rounded to the
+	// requested number of decimals and printed as whole and fractional part
+	long long scaled = std::llround(static_cast<double>(value) * scale);
+	reserve(MAX_TOKEN);
+	char* out = &buffer[used];
+	if (scaled < 0) {
+		*out++ = '-';
+		scaled = -scaled;
+	}
+	out = std::to_chars(out, out + MAX_TOKEN, scaled / scale).ptr;
+
+	long long fraction = scaled % scale;
+	if (decimals > 0 && (fraction != 0 || floatMode == FloatMode::Fixed)) {
+		*out++ = '.';
+		int digits = decimals;
+		if (floatMode == FloatMode::Shortest) {
+			while (fraction % 10 == 0) {
+				fraction /= 10;
+				digits--;
+			}
+		}
+		for (int i = digits - 1; i >= 0; i--) {
+			out[i] = '0' + static_cast<char>(fraction % 10);
+			fraction /= 10;
+		}
+		out += digits;
+	}
+	used = out - &buffer[0];
+}
+
+void TextWriter::reserve(size_t bytes) {
+	if (used + bytes > buffer.size()) flush();
+}
+
+void TextWriter::flush() {
+	if (used == 0) return;
+	file.write(&buffer[0], used);
+	used = 0;
+}
\ No newline at end of file
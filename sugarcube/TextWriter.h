@@ -0,0 +1,40 @@
+#pragma once
+#include <fstream>
+#include <vector>
+
+// buffered writer for large text files, numbers are formatted straight into
+// the buffer with std::to_chars and the buffer goes to disk in big blocks
+class TextWriter {
+
+public:
+	enum class FloatMode {
+		// always print the given number of decimals
+		Fixed,
+		// print up to the given number of decimals, dropping trailing zeros
+		Shortest
+	};
+
+public:
+	TextWriter(size_t bufferSize = 1 << 20);
+	~TextWriter();
+
+	bool open(const char* path);
+	bool close();
+	void setFloatMode(FloatMode mode, int decimals = 6);
+
+	void write(char c);
+	void write(const char* str);
+	void writeInt(long long value);
+	void writeFloat(float value);
+
+private:
+	void reserve(size_t bytes);
+	void flush();
+
+	std::ofstream file;
+	std::vector<char> buffer;
+	size_t used;
+	FloatMode floatMode;
+	int decimals;
+	long long scale;
+};
\ No newline at end of file
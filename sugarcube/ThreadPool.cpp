@@ -0,0 +1,107 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int threadCount) :
+	stopping(false)
+{
+	if (threadCount == 0) threadCount = 1;
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
+
+std::future<void> ThreadPool::enqueue(std::function<void()> task) {
+	std::packaged_task<void()> packaged(std::move(task));
+	std::future<void> result = packaged.get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push(std::move(packaged));
+	}
+	wake.notify_one();
+	return result;
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int)>& body) {
+	if (end <= begin) return;
+
+	// one task per worker pulling indices from a shared counter, so uneven
+	// iterations balance out; the calling thread helps instead of idling.
+	// Helpers that only start once the caller has closed the loop return
+	// at once, so the caller never waits on, or runs, anything queued
+	// behind them and nested loops can't deadlock
+	struct Loop {
+		std::atomic<int> next;
+		int end;
+		const std::function<void(int)>* body;
+		std::mutex mutex;
+		std::condition_variable finished;
+		int active;
+		bool closed;
+	};
+	std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+	loop->next = begin;
+	loop->end = end;
+	loop->body = &body;
+	loop->active = 0;
+	loop->closed = false;
+
+	auto run = [](Loop& loop) {
+		for (int i = loop.next++; i < loop.end; i = loop.next++) (*loop.body)(i);
+	};
+
+	int helpers = std::min(static_cast<int>(workers.size()), end - begin) - 1;
+	for (int i = 0; i < helpers; i++) {
+		enqueue([loop, run]() {
+			{
+				std::lock_guard<std::mutex> lock(loop->mutex);
+				if (loop->closed) return;
+				loop->active++;
+			}
+			run(*loop);
+			std::lock_guard<std::mutex> lock(loop->mutex);
+			if (--loop->active == 0) loop->finished.notify_all();
+		});
+	}
+	run(*loop);
+
+	// every index is taken, only wait for helpers still running their last
+	std::unique_lock<std::mutex> lock(loop->mutex);
+	loop->closed = true;
+	loop->finished.wait(lock, [&] { return loop->active == 0; });
+}
+
+unsigned int ThreadPool::size() const {
+	return static_cast<unsigned int>(workers.size());
+}
+
+void ThreadPool::work() {
+	TRACE_THREAD_NAME("worker");
+	while (true) {
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()) return;
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
\ No newline at end of file
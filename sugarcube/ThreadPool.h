@@ -0,0 +1,39 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads consuming a shared queue of tasks
+class ThreadPool {
+
+public:
+	ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	// pool shared by everything in the program that runs work in the
+	// background, sized to the number of hardware threads
+	static ThreadPool& shared();
+
+	std::future<void> enqueue(std::function<void()> task);
+
+	// runs body(i) for every i in [begin, end) across the pool and waits
+	// for all of them to finish. The calling thread takes part in the loop
+	// but never runs other queued tasks, so it can be nested inside pool
+	// tasks and called from the main thread without picking up unrelated work
+	void parallelFor(int begin, int end, const std::function<void(int)>& body);
+
+	unsigned int size() const;
+
+private:
+	void work();
+
+	std::vector<std::thread> workers;
+	std::queue<std::packaged_task<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+};
\ No newline at end of file
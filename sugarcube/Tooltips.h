@@ -5,4 +5,17 @@ namespace Tooltip {
 	static std::string maxSize = "The size in grid cells of the bounding volume that contains the voxels";
 	static std::string rules = "These cryptic values describe the rules of the cellular automaton, they are interpreted as follows:\n\nA live cell must have at least eL and at most eU neighbors to stay alive.\n\nA dead cell must have at least fL and at most fU neighbors to become a live cell.";
 	static std::string shaders = "Distance ramp: colors the structure with a gradient based on either the distance from the camera or the distance from the origin of space\n\n Normal / Light: color the structure based on the direction of each face or with a simple directional light";
+	static std::string occlusion = "Darkens the corners of faces that are surrounded by neighboring voxels, which helps dense structures read as solid shapes";
+	static std::string mergeFaces = "While paused, draw the structure as a single mesh with neighboring faces merged into larger rectangles, which is much cheaper for box-like results. Occlusion and blocky shading are not available in this mode";
+	static std::string history = "Past generations are kept in memory so the timeline in the info window can go back to them. The oldest generations are dropped once the history grows past this limit";
+	static std::string checkpoint = "Saves the grid, size, generation and rule so the run can be continued later. Loading replaces the current simulation and updates the controls to match";
+	static std::string runArchive = "Recording writes every generation to disk as the simulation runs. An opened run is played back with the play and step buttons or the timeline, and the simulation continues from the last recorded generation. Runs can also be played back with sugarcube --replay";
+	static std::string voxImport = "Starts from a structure made in MagicaVoxel, placed in the center of the grid. Set the max size large enough to hold it, anything outside of the grid is cut off";
+	static std::string sweep = "Runs every combination of the rule ranges, each from several random starting shapes in its own small grid, and sorts how they end: died out, exploded to fill half the grid, settled into a still life, repeated with a period or still changing after the last generation. Results are saved as csv or sgs, clicking one loads its rule and starting shape";
+	static std::string imageFormat = "ppm, pam and raw images are not compressed and are written straight from the graphics card's readback, the fastest way to dump frames for other tools. raw files have no header and can be read by ffmpeg with -f rawvideo -pixel_format rgb24 -video_size followed by the image size";
+	static std::string pngCompression = "Higher levels make smaller files but take longer to save, 0 saves the pixels without compressing them. Images are compressed in pieces on all cores either way";
+	static std::string antiAliasing = "Smooths the edges of the cubes in exported images. MSAA is cheap and only affects edges, supersampling renders the image several times larger and averages it down, which also smooths fine detail but takes longer. The two can be combined";
+	static std::string tiledExport = "Renders the image a piece at a time and writes it to disk as it goes, images larger than the graphics card can render at once are always exported this way. Tiled images can be saved in any format but jpg";
+	static std::string exportFrames = "Renders each generation of the range to its own numbered image at the image size and format above. The simulation steps forward from its current state, frames are saved in the background while the next ones render. Orbit camera turns the view a little more each frame";
+	static std::string exportAnimation = "Exports the range of generations as one animated glb, the simulation continues from its current state in the background without changing what is shown. Each block is written once and shown while it is alive";
 }
\ No newline at end of file
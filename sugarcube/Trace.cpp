@@ -0,0 +1,148 @@
+#include "Trace.h"
+
+#if SUGARCUBE_PROFILE
+
+#include <algorithm>
+#include <fstream>
+
+std::atomic<bool> Trace::enabled(false);
+std::mutex Trace::registryMutex;
+std::vector<Trace::ThreadBuffer*> Trace::registry;
+int Trace::nextId = 1;
+
+static const auto epoch = std::chrono::steady_clock::now();
+
+void Trace::setEnabled(bool enable) {
+	enabled.store(enable);
+}
+
+bool Trace::isEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+// the name given to this thread, kept until it records its first event
+static thread_local const char* currentThreadName = nullptr;
+
+void Trace::setThreadName(const char* name) {
+	currentThreadName = name;
+}
+
+uint64_t Trace::now() {
+	// microseconds, offset by one so that 0 can mean "not recording"
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+Trace::ThreadBuffer* Trace::threadBuffer() {
+	// gives the buffer back when the thread exits
+	struct Owner {
+		ThreadBuffer* buffer = nullptr;
+		~Owner() {
+			if (buffer) buffer->inUse.store(false, std::memory_order_release);
+		}
+	};
+	// registration takes the lock once per thread, recording never does
+	thread_local Owner owner;
+	if (owner.buffer == nullptr) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (ThreadBuffer* buffer : registry) {
+			if (!buffer->inUse.load(std::memory_order_acquire)) {
+				owner.buffer = buffer;
+				break;
+			}
+		}
+		if (owner.buffer == nullptr) {
+			owner.buffer = new ThreadBuffer();
+			for (Slot& slot : owner.buffer->slots) slot.sequence.store(0, std::memory_order_relaxed);
+			owner.buffer->head.store(0);
+			registry.push_back(owner.buffer);
+		}
+		ThreadBuffer* buffer = owner.buffer;
+		buffer->base.store(buffer->head.load());
+		buffer->id.store(nextId++);
+		buffer->name.store(currentThreadName);
+		buffer->inUse.store(true);
+	}
+	return owner.buffer;
+}
+
+void Trace::push(const Event& event) {
+	ThreadBuffer* buffer = threadBuffer();
+	uint64_t head = buffer->head.load(std::memory_order_relaxed);
+	Slot& slot = buffer->slots[head % CAPACITY];
+	// the sequence is cleared before the fields change and set again after
+	slot.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(event.name, std::memory_order_relaxed);
+	slot.start.store(event.start, std::memory_order_relaxed);
+	slot.duration.store(event.duration, std::memory_order_relaxed);
+	slot.value.store(event.value, std::memory_order_relaxed);
+	slot.isCounter.store(event.isCounter, std::memory_order_relaxed);
+	slot.sequence.store(head + 1, std::memory_order_release);
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::complete(const char* name, uint64_t start, uint64_t end) {
+	Event event = { name, start, end - start, 0, false };
+	push(event);
+}
+
+void Trace::counter(const char* name, int64_t value) {
+	Event event = { name, now(), 0, value, true };
+	push(event);
+}
+
+bool Trace::dump(const char* path) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	std::vector<ThreadBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffers = registry;
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	const char* separator = "";
+	for (ThreadBuffer* buffer : buffers) {
+		int id = buffer->id.load();
+		const char* name = buffer->name.load();
+		if (name != nullptr) {
+			file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+				<< id << ",\"args\":{\"name\":\"" << name << "\"}}";
+			separator = ",\n";
+		}
+
+		// once the ring has wrapped only the newest CAPACITY events remain.
+		// The owner keeps recording while this runs, a slot whose sequence
+		// changed while it was copied was overwritten and is left out
+		uint64_t base = buffer->base.load(std::memory_order_acquire);
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t tail = std::max(base, head > CAPACITY ? head - CAPACITY : 0);
+		for (uint64_t i = tail; i < head; i++) {
+			const Slot& slot = buffer->slots[i % CAPACITY];
+			uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			Event e = {
+				slot.name.load(std::memory_order_relaxed),
+				slot.start.load(std::memory_order_relaxed),
+				slot.duration.load(std::memory_order_relaxed),
+				slot.value.load(std::memory_order_relaxed),
+				slot.isCounter.load(std::memory_order_relaxed)
+			};
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence != i + 1 || slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+			file << separator << "{\"name\":\"" << e.name << "\",\"pid\":1,\"tid\":" << id
+				<< ",\"ts\":" << e.start;
+			if (e.isCounter) file << ",\"ph\":\"C\",\"args\":{\"value\":" << e.value << "}}";
+			else file << ",\"ph\":\"X\",\"dur\":" << e.duration << "}";
+			separator = ",\n";
+		}
+	}
+	file << "\n]}\n";
+
+	file.close();
+	return !file.fail();
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+// build with SUGARCUBE_PROFILE defined as 0 to compile all of the
+// instrumentation out, the macros below then expand to nothing
+#ifndef SUGARCUBE_PROFILE
+#define SUGARCUBE_PROFILE 1
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#if SUGARCUBE_PROFILE
+
+// records timed events into a ring buffer owned by each thread and writes
+// them out in the chrome trace_event format, which perfetto and
+// chrome://tracing can both open
+class Trace {
+
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+	// picked up when the thread records its first event
+	static void setThreadName(const char* name);
+
+	// names must be string literals, only the pointer is stored
+	static void complete(const char* name, uint64_t start, uint64_t end);
+	static void counter(const char* name, int64_t value);
+	static uint64_t now();
+
+	static bool dump(const char* path);
+
+private:
+	struct Event {
+		const char* name;
+		uint64_t start;
+		uint64_t duration;
+		int64_t value;
+		bool isCounter;
+	};
+
+	// one event of a ring, the fields are only written by the owning thread.
+	// sequence is 1 + the index of the event in the slot, or 0 while it is
+	// being written, so a dump running alongside can skip torn slots
+	struct Slot {
+		std::atomic<uint64_t> sequence;
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> start;
+		std::atomic<uint64_t> duration;
+		std::atomic<int64_t> value;
+		std::atomic<bool> isCounter;
+	};
+
+	// single producer ring, only the owning thread ever writes to it
+	static const uint64_t CAPACITY = 1 << 16;
+	struct ThreadBuffer {
+		Slot slots[CAPACITY];
+		std::atomic<uint64_t> head;
+		// events before base were recorded by an earlier owner
+		std::atomic<uint64_t> base;
+		std::atomic<const char*> name;
+		std::atomic<int> id;
+		// cleared when the owning thread exits, the buffer is then handed to
+		// the next thread that records
+		std::atomic<bool> inUse;
+	};
+
+	// only allocates once the thread records its first event
+	static ThreadBuffer* threadBuffer();
+	static void push(const Event& event);
+
+	static std::atomic<bool> enabled;
+
+	// every thread buffer ever created. Buffers are never freed, so the
+	// events of finished threads can still be written out until another
+	// thread reuses their buffer
+	static std::mutex registryMutex;
+	static std::vector<ThreadBuffer*> registry;
+	static int nextId;
+};
+
+class ScopedTrace {
+
+public:
+	ScopedTrace(const char* name) :
+		name(name),
+		start(Trace::isEnabled() ? Trace::now() : 0)
+	{}
+	~ScopedTrace() {
+		if (start != 0 && Trace::isEnabled())
+			Trace::complete(name, start, Trace::now());
+	}
+
+private:
+	const char* name;
+	uint64_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) ScopedTrace TRACE_CONCAT(scopedTrace, __LINE__)(name)
+#define TRACE_COUNTER(name, value) do { if (Trace::isEnabled()) Trace::counter(name, value); } while (0)
+#define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_COUNTER(name, value) do {} while (0)
+#define TRACE_THREAD_NAME(name)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include "UniformBuffer.h"
+#include <cstring>
+
+void UniformBuffer::initialize(GLuint binding, GLsizeiptr size) {
+	this->binding = binding;
+	contents.clear();
+	contents.resize(size);
+
+	glGenBuffers(1, &id);
+	glBindBuffer(GL_UNIFORM_BUFFER, id);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+
+	// force the first update to upload
+	std::memset(&contents[0], 0xff, contents.size());
+}
+
+void UniformBuffer::update(const void* data) {
+	// skip the upload if the block hasn't changed since last time
+	if (std::memcmp(&contents[0], data, contents.size()) == 0) return;
+	std::memcpy(&contents[0], data, contents.size());
+
+	glBindBuffer(GL_UNIFORM_BUFFER, id);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, contents.size(), &contents[0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+
+// uniform buffer object bound to a fixed binding point so that it can be
+// shared by every shader program that declares a block with that binding
+class UniformBuffer {
+
+public:
+	UniformBuffer() {}
+	void initialize(GLuint binding, GLsizeiptr size);
+	void update(const void* data);
+
+private:
+	GLuint id;
+	GLuint binding;
+	std::vector<unsigned char> contents;
+};
\ No newline at end of file
@@ -0,0 +1,384 @@
+#include "VoxFile.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+template<typename T>
+static void put(std::vector<char>& buffer, T value) {
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void putChunkHeader(std::vector<char>& buffer, const char* id, size_t content, size_t children) {
+	buffer.insert(buffer.end(), id, id + 4);
+	put(buffer, static_cast<int32_t>(content));
+	put(buffer, static_cast<int32_t>(children));
+}
+
+static void putString(std::vector<char>& buffer, const std::string& value) {
+	put(buffer, static_cast<int32_t>(value.size()));
+	buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+// scene graph chunks are built into their own buffer first, the header needs
+// the content size
+static void putChunk(std::vector<char>& buffer, const char* id, const std::vector<char>& content) {
+	putChunkHeader(buffer, id, content.size(), 0);
+	buffer.insert(buffer.end(), content.begin(), content.end());
+}
+
+// reads little endian values out of a chunk, reads past the end return zero
+class ChunkReader {
+
+public:
+	ChunkReader(const std::vector<char>& data) : data(data), at(0) {}
+
+	int32_t readInt() {
+		int32_t value = 0;
+		if (at + sizeof(value) <= data.size()) std::memcpy(&value, &data[at], sizeof(value));
+		at += sizeof(value);
+		return value;
+	}
+
+	std::string readString() {
+		int32_t length = readInt();
+		if (length < 0 || at + length > data.size()) {
+			at = data.size();
+			return "";
+		}
+		std::string value(&data[at], length);
+		at += length;
+		return value;
+	}
+
+	std::map<std::string, std::string> readDict() {
+		std::map<std::string, std::string> dict;
+		int32_t pairs = readInt();
+		for (int32_t i = 0; i < pairs && at < data.size(); i++) {
+			std::string key = readString();
+			dict[key] = readString();
+		}
+		return dict;
+	}
+
+private:
+	const std::vector<char>& data;
+	size_t at;
+};
+
+ivec3 VoxFile::toVox(ivec3 size) {
+	return ivec3(size.x, size.z, size.y);
+}
+
+bool VoxFile::write(const char* path, GridView grid,
+	const std::vector<uint8_t>* colorIndices, const std::vector<u8vec4>* palette)
+{
+	TRACE_SCOPE("writeVox");
+	if (!grid.isValid()) {
+		std::cout << "Can't export, no data" << std::endl;
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not write file to path\n" << path << std::endl;
+		return false;
+	}
+
+	// header and main chunk, whose children size is fixed up at the end
+	std::vector<char> buffer;
+	buffer.insert(buffer.end(), { 'V', 'O', 'X', ' ' });
+	put(buffer, static_cast<int32_t>(150));
+	putChunkHeader(buffer, "MAIN", 0, 0);
+	file.write(buffer.data(), buffer.size());
+	const std::streamoff childrenSizeAt = 16;
+	size_t childrenSize = 0;
+
+	ivec3 voxSize = toVox(grid.size);
+	ivec3 models = (voxSize + MODEL_SIZE - 1) / MODEL_SIZE;
+	int modelCount = models.x * models.y * models.z;
+
+	// models are encoded into separate buffers in parallel, one per thread
+	// at a time since a full model is 64 MiB, and written in order. Empty
+	// models are left out of the file
+	ThreadPool& pool = ThreadPool::shared();
+	int batch = pool.size();
+	std::vector<std::vector<char>> buffers(batch);
+	std::vector<ivec3> written;
+	for (int first = 0; first < modelCount; first += batch) {
+		int count = std::min(batch, modelCount - first);
+		pool.parallelFor(first, first + count, [&](int model) {
+			ivec3 origin = MODEL_SIZE * ivec3(
+				model % models.x, (model / models.x) % models.y, model / (models.x * models.y));
+			ivec3 extent = glm::min(ivec3(MODEL_SIZE), voxSize - origin);
+
+			std::vector<char> voxels;
+			for (int vz = 0; vz < extent.z; vz++) {
+				for (int vy = 0; vy < extent.y; vy++) {
+					for (int vx = 0; vx < extent.x; vx++) {
+						int x = origin.x + vx;
+						int y = origin.z + vz;
+						int z = grid.size.z - 1 - (origin.y + vy);
+						if (grid.isEmpty(x, y, z)) continue;
+						uint8_t color = colorIndices ? (*colorIndices)[grid.coordsToIndex(x, y, z)] : 1;
+						voxels.insert(voxels.end(), { static_cast<char>(vx), static_cast<char>(vy),
+							static_cast<char>(vz), static_cast<char>(color) });
+					}
+				}
+			}
+
+			std::vector<char>& out = buffers[model - first];
+			out.clear();
+			if (voxels.empty()) return;
+			putChunkHeader(out, "SIZE", 12, 0);
+			put(out, extent.x);
+			put(out, extent.y);
+			put(out, extent.z);
+			putChunkHeader(out, "XYZI", 4 + voxels.size(), 0);
+			put(out, static_cast<int32_t>(voxels.size() / 4));
+			out.insert(out.end(), voxels.begin(), voxels.end());
+		});
+
+		for (int i = 0; i < count; i++) {
+			if (buffers[i].empty()) continue;
+			int model = first + i;
+			written.push_back(MODEL_SIZE * ivec3(
+				model % models.x, (model / models.x) % models.y, model / (models.x * models.y)));
+			file.write(buffers[i].data(), buffers[i].size());
+			childrenSize += buffers[i].size();
+		}
+	}
+
+	// scene graph: a root transform and group, then a transform and shape
+	// for each model. Models are placed by their center like MagicaVoxel does
+	buffer.clear();
+	std::vector<char> content;
+	put(content, static_cast<int32_t>(0));
+	put(content, static_cast<int32_t>(0));
+	put(content, static_cast<int32_t>(1));
+	put(content, static_cast<int32_t>(-1));
+	put(content, static_cast<int32_t>(-1));
+	put(content, static_cast<int32_t>(1));
+	put(content, static_cast<int32_t>(0));
+	putChunk(buffer, "nTRN", content);
+
+	content.clear();
+	put(content, static_cast<int32_t>(1));
+	put(content, static_cast<int32_t>(0));
+	put(content, static_cast<int32_t>(written.size()));
+	for (size_t i = 0; i < written.size(); i++) put(content, static_cast<int32_t>(2 + 2 * i));
+	putChunk(buffer, "nGRP", content);
+
+	for (size_t i = 0; i < written.size(); i++) {
+		ivec3 extent = glm::min(ivec3(MODEL_SIZE), voxSize - written[i]);
+		ivec3 translation = written[i] + extent / 2 - voxSize / 2;
+		std::ostringstream t;
+		t << translation.x << " " << translation.y << " " << translation.z;
+
+		content.clear();
+		put(content, static_cast<int32_t>(2 + 2 * i));
+		put(content, static_cast<int32_t>(0));
+		put(content, static_cast<int32_t>(3 + 2 * i));
+		put(content, static_cast<int32_t>(-1));
+		put(content, static_cast<int32_t>(0));
+		put(content, static_cast<int32_t>(1));
+		put(content, static_cast<int32_t>(1));
+		putString(content, "_t");
+		putString(content, t.str());
+		putChunk(buffer, "nTRN", content);
+
+		content.clear();
+		put(content, static_cast<int32_t>(3 + 2 * i));
+		put(content, static_cast<int32_t>(0));
+		put(content, static_cast<int32_t>(1));
+		put(content, static_cast<int32_t>(i));
+		put(content, static_cast<int32_t>(0));
+		putChunk(buffer, "nSHP", content);
+	}
+
+	if (palette) {
+		putChunkHeader(buffer, "RGBA", 256 * 4, 0);
+		for (int i = 0; i < 256; i++) {
+			u8vec4 color = i < static_cast<int>(palette->size()) ? (*palette)[i] : u8vec4(0);
+			buffer.insert(buffer.end(), { static_cast<char>(color.r), static_cast<char>(color.g),
+				static_cast<char>(color.b), static_cast<char>(color.a) });
+		}
+	}
+
+	file.write(buffer.data(), buffer.size());
+	childrenSize += buffer.size();
+	file.seekp(childrenSizeAt);
+	int32_t children = static_cast<int32_t>(childrenSize);
+	file.write(reinterpret_cast<const char*>(&children), sizeof(children));
+	file.close();
+	return !file.fail();
+}
+
+bool VoxFile::read(const char* path, std::vector<bool>& cells, ivec3& size) {
+	TRACE_SCOPE("readVox");
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Error: could not open file\n" << path << std::endl;
+		return false;
+	}
+
+	char magic[4];
+	int32_t version;
+	file.read(magic, 4);
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	if (!file || std::memcmp(magic, "VOX ", 4) != 0) {
+		std::cout << "Error: not a vox file\n" << path << std::endl;
+		return false;
+	}
+
+	// chunks are read one at a time, the children of MAIN follow its header
+	// directly so nesting can be ignored
+	std::vector<Model> models;
+	std::map<int, std::pair<int, ivec3>> transforms;
+	std::map<int, std::vector<int>> groups;
+	std::map<int, int> shapes;
+	std::vector<char> content;
+	char id[4];
+	int32_t sizes[2];
+	while (file.read(id, 4) && file.read(reinterpret_cast<char*>(sizes), sizeof(sizes))) {
+		if (sizes[0] < 0) break;
+		content.resize(sizes[0]);
+		if (sizes[0] > 0 && !file.read(content.data(), sizes[0])) break;
+		ChunkReader reader(content);
+		std::string chunk(id, 4);
+
+		if (chunk == "SIZE") {
+			Model model;
+			model.size.x = reader.readInt();
+			model.size.y = reader.readInt();
+			model.size.z = reader.readInt();
+			// magicavoxel models are at most 256 cells a side, anything else
+			// is a broken file and must not decide how much is allocated
+			if (glm::any(glm::lessThan(model.size, ivec3(1))) ||
+				glm::any(glm::greaterThan(model.size, ivec3(MODEL_SIZE))))
+			{
+				std::cout << "Error: the vox file has a model of invalid size\n" << path << std::endl;
+				return false;
+			}
+			models.push_back(std::move(model));
+		}
+		else if (chunk == "XYZI" && !models.empty()) {
+			// decoded later, once all instances are known
+			int32_t count = std::max(0, reader.readInt());
+			size_t bytes = std::min(static_cast<size_t>(count) * 4, content.size() - 4);
+			models.back().voxels.assign(content.begin() + 4, content.begin() + 4 + bytes);
+		}
+		else if (chunk == "nTRN") {
+			int node = reader.readInt();
+			reader.readDict();
+			int child = reader.readInt();
+			reader.readInt();
+			reader.readInt();
+			int frames = reader.readInt();
+			ivec3 translation(0);
+			if (frames > 0) {
+				std::istringstream t(reader.readDict()["_t"]);
+				t >> translation.x >> translation.y >> translation.z;
+			}
+			transforms[node] = { child, translation };
+		}
+		else if (chunk == "nGRP") {
+			int node = reader.readInt();
+			reader.readDict();
+			int count = reader.readInt();
+			for (int i = 0; i < count; i++) groups[node].push_back(reader.readInt());
+		}
+		else if (chunk == "nSHP") {
+			int node = reader.readInt();
+			reader.readDict();
+			if (reader.readInt() > 0) shapes[node] = reader.readInt();
+		}
+	}
+
+	// walk the scene graph summing translations, files without one place
+	// every model at the origin
+	std::vector<Instance> instances;
+	if (transforms.empty()) {
+		for (size_t i = 0; i < models.size(); i++) instances.push_back({ static_cast<int>(i), ivec3(0) });
+	}
+	else {
+		// every node sits in the tree once, reaching one again means the
+		// file loops back on itself and would be walked forever
+		std::vector<std::pair<int, ivec3>> stack = { { 0, ivec3(0) } };
+		std::set<int> visited;
+		while (!stack.empty()) {
+			std::pair<int, ivec3> node = stack.back();
+			stack.pop_back();
+			if (!visited.insert(node.first).second) {
+				std::cout << "Error: the vox file has a broken scene graph\n" << path << std::endl;
+				return false;
+			}
+			if (transforms.count(node.first)) {
+				const std::pair<int, ivec3>& transform = transforms[node.first];
+				stack.push_back({ transform.first, node.second + transform.second });
+			}
+			else if (groups.count(node.first)) {
+				for (int child : groups[node.first]) stack.push_back({ child, node.second });
+			}
+			else if (shapes.count(node.first) && shapes[node.first] < static_cast<int>(models.size())) {
+				instances.push_back({ shapes[node.first], node.second });
+			}
+		}
+	}
+	if (instances.empty()) {
+		std::cout << "Error: the vox file has no models\n" << path << std::endl;
+		return false;
+	}
+
+	// bounds of the placed models in vox space
+	ivec3 low(INT_MAX);
+	ivec3 high(INT_MIN);
+	for (const Instance& instance : instances) {
+		ivec3 extent = models[instance.model].size;
+		ivec3 origin = instance.translation - extent / 2;
+		low = glm::min(low, origin);
+		high = glm::max(high, origin + extent);
+	}
+	ivec3 voxSize = high - low;
+	// cells are addressed with an int below
+	if (static_cast<int64_t>(voxSize.x) * voxSize.y * voxSize.z > INT_MAX) {
+		std::cout << "Error: the vox scene is too large to import\n" << path << std::endl;
+		return false;
+	}
+	size = ivec3(voxSize.x, voxSize.z, voxSize.y);
+	cells.assign(static_cast<size_t>(size.x) * size.y * size.z, false);
+
+	// instances are decoded into cell indices in parallel, setting the bits
+	// stays on this thread since neighbouring bits share a word
+	std::vector<std::vector<int>> decoded(instances.size());
+	ThreadPool::shared().parallelFor(0, static_cast<int>(instances.size()), [&](int i) {
+		const Model& model = models[instances[i].model];
+		ivec3 origin = instances[i].translation - model.size / 2 - low;
+		std::vector<int>& indices = decoded[i];
+		indices.reserve(model.voxels.size() / 4);
+		for (size_t v = 0; v + 4 <= model.voxels.size(); v += 4) {
+			ivec3 local(static_cast<uint8_t>(model.voxels[v]),
+				static_cast<uint8_t>(model.voxels[v + 1]),
+				static_cast<uint8_t>(model.voxels[v + 2]));
+			if (glm::any(glm::greaterThanEqual(local, model.size))) continue;
+			ivec3 vox = origin + local;
+			int x = vox.x;
+			int y = vox.z;
+			int z = voxSize.y - 1 - vox.y;
+			indices.push_back(z * size.x * size.y + y * size.x + x);
+		}
+	});
+	for (const std::vector<int>& indices : decoded) {
+		for (int index : indices) cells[index] = true;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "GridView.h"
+
+using ivec3 = glm::ivec3;
+using u8vec4 = glm::u8vec4;
+
+// reads and writes MagicaVoxel .vox files. Grids larger than the format's
+// 256^3 model limit are split into models placed by a scene graph. The vox
+// z axis points up, so sugarcube's y becomes vox z and z becomes -y
+class VoxFile {
+
+public:
+	// colorIndices holds a palette index from 1 to 255 for every cell, without
+	// it every voxel uses index 1. The palette replaces the default one when
+	// given, entry i is used by index i + 1
+	static bool write(const char* path, GridView grid,
+		const std::vector<uint8_t>* colorIndices = nullptr,
+		const std::vector<u8vec4>* palette = nullptr);
+	// every model instance of the scene is merged into one grid that is
+	// just large enough to hold them, node rotations are ignored
+	static bool read(const char* path, std::vector<bool>& cells, ivec3& size);
+
+	static const int MODEL_SIZE = 256;
+
+private:
+	struct Model {
+		ivec3 size;
+		std::vector<char> voxels;
+	};
+	struct Instance {
+		int model;
+		ivec3 translation;
+	};
+
+	static ivec3 toVox(ivec3 size);
+};
\ No newline at end of file
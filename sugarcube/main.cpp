@@ -1,21 +1,24 @@
 #define IMGUI_IMPL_OPENGL_LOADER_GLAD
 
-#include <imgui\imgui.h>
-#include <imgui\imgui_impl_glfw.h>
-#include <imgui\imgui_impl_opengl3.h>
+#include <imgui/imgui.h>
+#include <imgui/imgui_impl_glfw.h>
+#include <imgui/imgui_impl_opengl3.h>
 
-#include <glad\glad.h>
-#include <GLFW\glfw3.h>
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <string>
 #include <fstream>
 #include <iostream>
 
 #include "Sugarcube.h"
+#include "Cli.h"
+#include "GLContext.h"
 #include "OrthoCamera.h"
 #include "PerspCamera.h"
+#include "Trace.h"
 
 using vec2 = glm::vec2;
 using vec3 = glm::vec3;
@@ -27,34 +30,50 @@ const GLsizei SCREEN_WIDTH = 1100;
 const GLsizei SCREEN_HEIGHT = 800;
 const float SIDEBAR_WIDTH = 300.0f;
 
+// frame rate cap while something is animating, and the longest the event
+// loop will sleep when nothing is
+const double FRAME_INTERVAL = 1.0 / 60.0;
+const double IDLE_TIMEOUT = 0.5;
+
 float lastFrame;
 float elapsed;
 
 Sugarcube sugarcube(SCREEN_WIDTH, SCREEN_HEIGHT, SIDEBAR_WIDTH);
 
 void resizeCallback(GLFWwindow* window, int width, int height);
-
-int main() {
-	// initialize GLFW
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	// create window and OpenGL context
-	GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "sugarcube", NULL, NULL);
-	if (window == NULL) {
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
+void refreshCallback(GLFWwindow* window);
+void cursorCallback(GLFWwindow* window, double x, double y);
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+void scrollCallback(GLFWwindow* window, double x, double y);
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void charCallback(GLFWwindow* window, unsigned int c);
+
+int main(int argc, char** argv) {
+	TRACE_THREAD_NAME("main");
+
+	// command line modes run without a window
+	if (argc > 1 && std::string(argv[1]) == "--replay") return runReplay(argc - 2, argv + 2);
+	if (argc > 1 && std::string(argv[1]) == "--batch") return runBatch(argc - 2, argv + 2);
+
+	// otherwise the only argument is a run archive to play back
+	const char* archivePath = nullptr;
+	if (argc > 1) {
+		if (argv[1][0] == '-') {
+			std::cout << "Unknown option " << argv[1] << std::endl;
+			std::cout << "Usage: sugarcube [archive] | --replay <archive> ... | --batch ..." << std::endl;
+			return 1;
+		}
+		if (argc > 2) {
+			std::cout << "Unexpected argument " << argv[2] << std::endl;
+			return 1;
+		}
+		archivePath = argv[1];
 	}
-	glfwMakeContextCurrent(window);
 
-	// initialize GLAD
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		return -1;
-	}
+	// create window and OpenGL context
+	GLContext context;
+	if (!context.create(ContextBackend::Window, SCREEN_WIDTH, SCREEN_HEIGHT)) return -1;
+	GLFWwindow* window = context.getWindow();
 
 	// create viewport
 	glViewport(0, 0, SCREEN_WIDTH - SIDEBAR_WIDTH, SCREEN_HEIGHT);
@@ -63,6 +82,15 @@ int main() {
 	// resize callback
 	glfwSetFramebufferSizeCallback(window, resizeCallback);
 
+	// input callbacks, these only wake the event loop for a redraw
+	// imgui chains its own callbacks onto the ones installed here
+	glfwSetWindowRefreshCallback(window, refreshCallback);
+	glfwSetCursorPosCallback(window, cursorCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetScrollCallback(window, scrollCallback);
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetCharCallback(window, charCallback);
+
 	// SETUP IMGUI
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -76,10 +104,17 @@ int main() {
 	sugarcube.camera = &camera;
 
 	sugarcube.initialize();
+	if (archivePath) sugarcube.openArchive(archivePath);
 
 	// event loop
+	double nextFrame = 0.0;
 	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+		// block until an event arrives when paused and untouched,
+		// otherwise wait out the rest of the frame interval
+		double wait = nextFrame - glfwGetTime();
+		if (sugarcube.isIdle()) glfwWaitEventsTimeout(IDLE_TIMEOUT);
+		else if (wait > 0.0) glfwWaitEventsTimeout(wait);
+		else glfwPollEvents();
 		camera.handleMouse();
 
 		float currentTime = glfwGetTime();
@@ -87,12 +122,23 @@ int main() {
 		lastFrame = currentTime;
 
 		sugarcube.update(dt);
+		if (currentTime < nextFrame) continue;
+		nextFrame = currentTime + FRAME_INTERVAL;
+		if (!sugarcube.needsRedraw()) continue;
+
 		sugarcube.draw();
 
 		glfwSwapBuffers(window);
 	}
 
-	glfwTerminate();
+	sugarcube.shutdown();
+
+#if SUGARCUBE_PROFILE
+	// write out whatever was recorded if tracing was left on
+	if (Trace::isEnabled()) Trace::dump("trace.json");
+#endif
+
+	context.destroy();
 	return 0;
 }
 
@@ -100,4 +146,12 @@ void resizeCallback(GLFWwindow* window, int width, int height) {
 	sugarcube.resize(width, height);
 	sugarcube.camera->setSize(width - SIDEBAR_WIDTH, height);
 	glViewport(0, 0, width - SIDEBAR_WIDTH, height);
-}
\ No newline at end of file
+	sugarcube.requestRedraw();
+}
+
+void refreshCallback(GLFWwindow* window) { sugarcube.requestRedraw(); }
+void cursorCallback(GLFWwindow* window, double x, double y) { sugarcube.requestRedraw(); }
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) { sugarcube.requestRedraw(); }
+void scrollCallback(GLFWwindow* window, double x, double y) { sugarcube.requestRedraw(); }
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) { sugarcube.requestRedraw(); }
+void charCallback(GLFWwindow* window, unsigned int c) { sugarcube.requestRedraw(); }
\ No newline at end of file
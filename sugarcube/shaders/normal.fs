@@ -4,19 +4,39 @@ out vec4 fragColor;
 in vec3 vNormal;
 in vec3 clipSpacePos;
 in float vDistance;
+in float vOcclusion;
 
-uniform vec4 xColor;
-uniform vec4 yColor;
-uniform vec4 zColor;
-uniform vec4 ambientColor;
-uniform vec4 lightColor;
-uniform vec3 lightDir;
-uniform float normalMix;
-uniform float lightMix;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+};
+
+layout (std140) uniform Shading {
+	vec4 nearColor;
+	vec4 farColor;
+	vec4 innerColor;
+	vec4 outerColor;
+	vec4 xColor;
+	vec4 yColor;
+	vec4 zColor;
+	vec4 ambientColor;
+	vec4 lightColor;
+	vec3 lightDir;
+	float rampMode;
+	float cameraRampScale;
+	float cameraRampOffset;
+	float originRampScale;
+	float originRampOffset;
+	float normalMix;
+	float lightMix;
+	float occlusionStrength;
+	int smoothLight;
+};
 
 void main() {
 	vec4 normalColors = xColor * abs(vNormal.x) + yColor * abs(vNormal.y) + zColor * abs(vNormal.z);
 	vec4 lit = max(dot(normalize(-lightDir), vNormal), 0) * lightColor;
 
 	fragColor = mix(ambientColor, normalColors, normalMix) + lit * lightMix;
+	fragColor.rgb *= 1.0 - occlusionStrength * (1.0 - vOcclusion);
 }
\ No newline at end of file
@@ -4,16 +4,34 @@ out vec4 fragColor;
 in vec3 vNormal;
 in vec3 clipSpacePos;
 in float vDistance;
+in float vOcclusion;
 
-uniform vec4 nearColor;
-uniform vec4 farColor;
-uniform vec4 innerColor;
-uniform vec4 outerColor;
-uniform float cameraRampScale;
-uniform float cameraRampOffset;
-uniform float originRampScale;
-uniform float originRampOffset;
-uniform float rampMode;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+};
+
+layout (std140) uniform Shading {
+	vec4 nearColor;
+	vec4 farColor;
+	vec4 innerColor;
+	vec4 outerColor;
+	vec4 xColor;
+	vec4 yColor;
+	vec4 zColor;
+	vec4 ambientColor;
+	vec4 lightColor;
+	vec3 lightDir;
+	float rampMode;
+	float cameraRampScale;
+	float cameraRampOffset;
+	float originRampScale;
+	float originRampOffset;
+	float normalMix;
+	float lightMix;
+	float occlusionStrength;
+	int smoothLight;
+};
 
 void main() {
 	float mixO = vDistance * (1 / originRampScale) + originRampOffset;
@@ -23,4 +41,5 @@ void main() {
 	vec4 cameraRamp = mix(nearColor, farColor, mixC);
 
 	fragColor = mix(originRamp, cameraRamp, rampMode);
+	fragColor.rgb *= 1.0 - occlusionStrength * (1.0 - vOcclusion);
 }
\ No newline at end of file
@@ -2,18 +2,48 @@
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec3 offset;
+layout (location = 3) in uvec2 occlusion;
 
 out vec3 vNormal;
 out float vDistance;
 out vec3 clipSpacePos;
+out float vOcclusion;
 
-uniform mat4 view;
-uniform mat4 projection;
-uniform int smoothLight;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+};
+
+layout (std140) uniform Shading {
+	vec4 nearColor;
+	vec4 farColor;
+	vec4 innerColor;
+	vec4 outerColor;
+	vec4 xColor;
+	vec4 yColor;
+	vec4 zColor;
+	vec4 ambientColor;
+	vec4 lightColor;
+	vec3 lightDir;
+	float rampMode;
+	float cameraRampScale;
+	float cameraRampOffset;
+	float originRampScale;
+	float originRampOffset;
+	float normalMix;
+	float lightMix;
+	float occlusionStrength;
+	int smoothLight;
+};
 
 void main() {
 	vec4 vPos = vec4(pos + offset, 1);
 	vNormal = normal;
+
+	// unpack the 2 bit occlusion value of this cube vertex
+	uint bits = gl_VertexID < 16 ? occlusion.x : occlusion.y;
+	vOcclusion = float((bits >> (2u * uint(gl_VertexID % 16))) & 3u) / 3.0;
+
 	vDistance = length(pos * smoothLight + offset);
 	clipSpacePos = (projection * view * vec4(pos * smoothLight + offset, 1)).xyz;
 